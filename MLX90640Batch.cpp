@@ -0,0 +1,320 @@
+#include "MLX90640Batch.h"
+#include <cstddef>
+#include <vector>
+#pragma GCC optimize ("O3")
+
+#if defined(__x86_64__) || defined(__i386__)
+   #define MLX90640BATCH_X86
+   #include <immintrin.h>
+#elif defined(__aarch64__)
+   #define MLX90640BATCH_NEON
+   #include <arm_neon.h>
+#endif
+
+namespace {
+
+/* everything of one frame, that doesn't depend on the pixel. */
+struct FrameConstants {
+  float Gain;
+  float dTa;
+  float dVdd;
+  float KsTa;
+  float CP;
+  float Emissivity;
+  float TaTr;
+  float KsTo1Factor; // 1 - ksTo[1] * 273.15
+  float KsTo[4];
+  float Ct[4];
+  float AlphaCorrR[4];
+  bool  ILChess;
+};
+
+/* the driver's sqrt(sqrt()) on float arguments is the double one (C++
+ * <tgmath.h> doesn't add float overloads to the global namespace), so the
+ * roots and the operation following them are done in double here as well.
+ */
+inline double Root4(float x) {
+  return sqrt(sqrt((double) x));
+}
+
+typedef void (*FrameFn)(const FrameConstants& c, const uint16_t* Raw, const preparedMLX90640* p,
+                        const float* IL, const float* Conv, float* Out);
+
+/* all 768 pixels, as MLX90640_CalculateToPrepared() in exact mode. */
+void FrameScalar(const FrameConstants& c, const uint16_t* Raw, const preparedMLX90640* p,
+                 const float* IL, const float* Conv, float* Out) {
+  for(int i = 0; i < 768; i++) {
+     float ir = (int16_t) Raw[i];
+     ir = ir * c.Gain;
+     ir = ir - p->offset[i] * (1.0f + p->kta[i] * c.dTa) * (1.0f + p->kv[i] * c.dVdd);
+     if (c.ILChess)
+        ir = ir + IL[i] - Conv[i];
+     ir = ir - c.CP;
+     ir = ir / c.Emissivity;
+
+     float a  = p->alpha[i] * c.KsTa;
+     float Sx = a * a * a * (ir + a * c.TaTr);
+     Sx = Root4(Sx) * c.KsTo[1];
+
+     float To = ir / (a * c.KsTo1Factor + Sx) + c.TaTr;
+     To = Root4(To) - 273.15f;
+
+     int r = To < c.Ct[1] ? 0 : To < c.Ct[2] ? 1 : To < c.Ct[3] ? 2 : 3;
+
+     To = ir / (a * c.AlphaCorrR[r] * (1.0f + c.KsTo[r] * (To - c.Ct[r]))) + c.TaTr;
+     Out[i] = Root4(To) - 273.15f;
+     }
+}
+
+#ifdef MLX90640BATCH_X86
+/* Root4(x) * Mul - Sub for 8 floats, as two 4x double vectors. */
+__attribute__((target("avx2")))
+inline __m256 Root4AVX2(__m256 x, __m256d Mul, __m256d Sub) {
+  __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+  __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+  lo = _mm256_sub_pd(_mm256_mul_pd(_mm256_sqrt_pd(_mm256_sqrt_pd(lo)), Mul), Sub);
+  hi = _mm256_sub_pd(_mm256_mul_pd(_mm256_sqrt_pd(_mm256_sqrt_pd(hi)), Mul), Sub);
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+
+/* 8 pixels per iteration; the range selected by blends, NaN as range 3. */
+__attribute__((target("avx2")))
+void FrameAVX2(const FrameConstants& c, const uint16_t* Raw, const preparedMLX90640* p,
+               const float* IL, const float* Conv, float* Out) {
+  const __m256  One    = _mm256_set1_ps(1.0f);
+  const __m256d Unit   = _mm256_set1_pd(1.0);
+  const __m256d Zero   = _mm256_set1_pd(0.0);
+  const __m256d Kelvin = _mm256_set1_pd(273.15f);
+  const __m256d KsTo1  = _mm256_set1_pd(c.KsTo[1]);
+  const __m256  Gain   = _mm256_set1_ps(c.Gain);
+  const __m256  dTa    = _mm256_set1_ps(c.dTa);
+  const __m256  dVdd   = _mm256_set1_ps(c.dVdd);
+  const __m256  KsTa   = _mm256_set1_ps(c.KsTa);
+  const __m256  CP     = _mm256_set1_ps(c.CP);
+  const __m256  Em     = _mm256_set1_ps(c.Emissivity);
+  const __m256  TaTr   = _mm256_set1_ps(c.TaTr);
+  const __m256  K1     = _mm256_set1_ps(c.KsTo1Factor);
+  __m256 KsTo[4], Ct[4], AlphaCorrR[4];
+  for(int r = 0; r < 4; r++) {
+     KsTo[r]       = _mm256_set1_ps(c.KsTo[r]);
+     Ct[r]         = _mm256_set1_ps(c.Ct[r]);
+     AlphaCorrR[r] = _mm256_set1_ps(c.AlphaCorrR[r]);
+     }
+
+  for(int i = 0; i < 768; i += 8) {
+     __m256 ir = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(Raw + i))));
+     ir = _mm256_mul_ps(ir, Gain);
+     __m256 Kta = _mm256_add_ps(One, _mm256_mul_ps(_mm256_loadu_ps(p->kta + i), dTa));
+     __m256 Kv  = _mm256_add_ps(One, _mm256_mul_ps(_mm256_loadu_ps(p->kv  + i), dVdd));
+     ir = _mm256_sub_ps(ir, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(p->offset + i), Kta), Kv));
+     if (c.ILChess)
+        ir = _mm256_sub_ps(_mm256_add_ps(ir, _mm256_loadu_ps(IL + i)), _mm256_loadu_ps(Conv + i));
+     ir = _mm256_sub_ps(ir, CP);
+     ir = _mm256_div_ps(ir, Em);
+
+     __m256 a  = _mm256_mul_ps(_mm256_loadu_ps(p->alpha + i), KsTa);
+     __m256 Sx = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(a, a), a),
+                               _mm256_add_ps(ir, _mm256_mul_ps(a, TaTr)));
+     Sx = Root4AVX2(Sx, KsTo1, Zero);
+
+     __m256 To = _mm256_add_ps(_mm256_div_ps(ir, _mm256_add_ps(_mm256_mul_ps(a, K1), Sx)), TaTr);
+     To = Root4AVX2(To, Unit, Kelvin);
+
+     __m256 k = KsTo[0], t = Ct[0], ac = AlphaCorrR[0];
+     for(int r = 1; r < 4; r++) {
+        __m256 m = _mm256_cmp_ps(To, Ct[r], _CMP_NLT_UQ);
+        k  = _mm256_blendv_ps(k,  KsTo[r],       m);
+        t  = _mm256_blendv_ps(t,  Ct[r],         m);
+        ac = _mm256_blendv_ps(ac, AlphaCorrR[r], m);
+        }
+
+     __m256 d = _mm256_mul_ps(_mm256_mul_ps(a, ac),
+                              _mm256_add_ps(One, _mm256_mul_ps(k, _mm256_sub_ps(To, t))));
+     To = _mm256_add_ps(_mm256_div_ps(ir, d), TaTr);
+     _mm256_storeu_ps(Out + i, Root4AVX2(To, Unit, Kelvin));
+     }
+}
+#endif
+
+#ifdef MLX90640BATCH_NEON
+/* Root4(x) * Mul - Sub for 4 floats, as two 2x double vectors. */
+inline float32x4_t Root4NEON(float32x4_t x, double Mul, double Sub) {
+  float64x2_t lo = vcvt_f64_f32(vget_low_f32(x));
+  float64x2_t hi = vcvt_high_f64_f32(x);
+  lo = vsubq_f64(vmulq_n_f64(vsqrtq_f64(vsqrtq_f64(lo)), Mul), vdupq_n_f64(Sub));
+  hi = vsubq_f64(vmulq_n_f64(vsqrtq_f64(vsqrtq_f64(hi)), Mul), vdupq_n_f64(Sub));
+  return vcvt_high_f32_f64(vcvt_f32_f64(lo), hi);
+}
+
+/* 4 pixels per iteration, vmul + vadd instead of vfma. */
+void FrameNEON(const FrameConstants& c, const uint16_t* Raw, const preparedMLX90640* p,
+               const float* IL, const float* Conv, float* Out) {
+  const float32x4_t One    = vdupq_n_f32(1.0f);
+  const double      Kelvin = 273.15f;
+  const float32x4_t TaTr   = vdupq_n_f32(c.TaTr);
+  const float32x4_t Em     = vdupq_n_f32(c.Emissivity);
+
+  for(int i = 0; i < 768; i += 4) {
+     float32x4_t ir = vcvtq_f32_s32(vmovl_s16(vld1_s16((const int16_t*)(Raw + i))));
+     ir = vmulq_n_f32(ir, c.Gain);
+     float32x4_t Kta = vaddq_f32(One, vmulq_n_f32(vld1q_f32(p->kta + i), c.dTa));
+     float32x4_t Kv  = vaddq_f32(One, vmulq_n_f32(vld1q_f32(p->kv  + i), c.dVdd));
+     ir = vsubq_f32(ir, vmulq_f32(vmulq_f32(vld1q_f32(p->offset + i), Kta), Kv));
+     if (c.ILChess)
+        ir = vsubq_f32(vaddq_f32(ir, vld1q_f32(IL + i)), vld1q_f32(Conv + i));
+     ir = vsubq_f32(ir, vdupq_n_f32(c.CP));
+     ir = vdivq_f32(ir, Em);
+
+     float32x4_t a  = vmulq_n_f32(vld1q_f32(p->alpha + i), c.KsTa);
+     float32x4_t Sx = vmulq_f32(vmulq_f32(vmulq_f32(a, a), a), vaddq_f32(ir, vmulq_f32(a, TaTr)));
+     Sx = Root4NEON(Sx, c.KsTo[1], 0.0);
+
+     float32x4_t To = vaddq_f32(vdivq_f32(ir, vaddq_f32(vmulq_n_f32(a, c.KsTo1Factor), Sx)), TaTr);
+     To = Root4NEON(To, 1.0, Kelvin);
+
+     float32x4_t k = vdupq_n_f32(c.KsTo[0]), t = vdupq_n_f32(c.Ct[0]), ac = vdupq_n_f32(c.AlphaCorrR[0]);
+     for(int r = 1; r < 4; r++) {
+        uint32x4_t m = vmvnq_u32(vcltq_f32(To, vdupq_n_f32(c.Ct[r])));
+        k  = vbslq_f32(m, vdupq_n_f32(c.KsTo[r]),       k);
+        t  = vbslq_f32(m, vdupq_n_f32(c.Ct[r]),         t);
+        ac = vbslq_f32(m, vdupq_n_f32(c.AlphaCorrR[r]), ac);
+        }
+
+     float32x4_t d = vmulq_f32(vmulq_f32(a, ac), vaddq_f32(One, vmulq_f32(k, vsubq_f32(To, t))));
+     To = vaddq_f32(vdivq_f32(ir, d), TaTr);
+     vst1q_f32(Out + i, Root4NEON(To, 1.0, Kelvin));
+     }
+}
+#endif
+
+FrameFn Kernel(UpscalerISA isa) {
+  if (!UpscalerHasISA(isa))
+     return FrameScalar;
+
+  switch(isa) {
+#ifdef MLX90640BATCH_X86
+     case UpscalerISA::AVX2: return FrameAVX2;
+#endif
+#ifdef MLX90640BATCH_NEON
+     case UpscalerISA::NEON: return FrameNEON;
+#endif
+     default:                return FrameScalar;
+     }
+}
+
+void Setup(const paramsMLX90640* Params, uint16_t* Frame, float Emissivity, float Tr,
+           FrameConstants& c) {
+  frameContextMLX90640 Context;
+  MLX90640_GetFrameContext(Frame, Params, &Context);
+  MLX90640_SetFrameEmissivity(&Context, Emissivity, std::isnan(Tr) ? Context.ta - 8.0f : Tr);
+
+  c.Gain        = Context.gain;
+  c.dTa         = Context.ta - 25.0f;
+  c.dVdd        = Context.vdd - 3.3f;
+  c.KsTa        = 1.0f + Params->KsTa * c.dTa;
+  c.CP          = Params->tgc * Context.irDataCP[Context.subPage & 1];
+  c.Emissivity  = Context.emissivity;
+  c.TaTr        = Context.taTr;
+  c.KsTo1Factor = 1.0f - Params->ksTo[1] * 273.15f;
+  c.ILChess     = Context.mode != Params->calibrationModeEE;
+  for(int r = 0; r < 4; r++) {
+     c.KsTo[r]       = Params->ksTo[r];
+     c.Ct[r]         = Params->ct[r];
+     c.AlphaCorrR[r] = Context.alphaCorrR[r];
+     }
+}
+
+inline void Store(const float* From, float* To) {
+  if (From != To)
+     for(int i = 0; i < 768; i++)
+        To[i] = From[i];
+}
+
+inline void Store(const float* From, int16_t* To) {
+  for(int i = 0; i < 768; i++) {
+     float v = From[i] * 100.0f;
+     To[i] = std::isnan(v) ? INT16_MIN : v >= 32767.0f ? INT16_MAX : v <= -32768.0f ? INT16_MIN :
+             (int16_t) lrintf(v);
+     }
+}
+
+inline float*   Direct(float* Cube)   { return Cube; }
+inline float*   Direct(int16_t*)      { return NULL; }
+inline float    Missing(float*)       { return NAN; }
+inline int16_t  Missing(int16_t*)     { return INT16_MIN; }
+
+} // namespace
+
+MLX90640Batch::MLX90640Batch(const paramsMLX90640* Params, const preparedMLX90640* Prepared) :
+  Params(Params), Prepared(Prepared), ISA(UpscalerBestISA()), Pool(NULL),
+  Emissivity(0.95f), Tr(NAN) {
+  for(int i = 0; i < 768; i++) {
+     int ilPattern  = (i >> 5) & 1;
+     int Conversion = ((i + 2) / 4 - (i + 3) / 4 + (i + 1) / 4 - i / 4) * (1 - 2 * ilPattern);
+     IL[i]   = Prepared->pattern[i] & MLX90640_IL_PATTERN ? Params->ilChessC[2] : Params->ilChessC[2] * -1;
+     Conv[i] = Params->ilChessC[1] * Conversion;
+     }
+}
+
+void MLX90640Batch::SetISA(UpscalerISA isa) {
+  ISA = isa;
+}
+
+void MLX90640Batch::SetThreadPool(UpscalerPool* Pool) {
+  this->Pool = Pool;
+}
+
+void MLX90640Batch::SetObject(float Emissivity, float Tr) {
+  this->Emissivity = Emissivity;
+  this->Tr = Tr;
+}
+
+bool MLX90640Batch::Active(const uint16_t* Frame, uint16_t Pixel) const {
+  uint8_t Bit = (Frame[832] & 0x1000) ? MLX90640_CHESS_PATTERN : MLX90640_IL_PATTERN;
+  return Frame[833] < 2 and ((Prepared->pattern[Pixel] & Bit) ? 1 : 0) == Frame[833];
+}
+
+template<typename T>
+void MLX90640Batch::Run(uint16_t* Frames, uint32_t Count, T* Cube) {
+  FrameFn Fn       = Kernel(ISA);
+  uint8_t Threads  = Pool ? Pool->Threads() : 1;
+  uint32_t Chunk   = 16;
+  while((Count + Chunk - 1) / Chunk > 0xFFFF)
+     Chunk *= 2;
+  uint16_t Jobs    = (Count + Chunk - 1) / Chunk;
+  std::vector<float> Buffer(Direct(Cube) ? 0 : 768 * Threads);
+
+  auto Job = [&](uint16_t Job, uint8_t Thread) {
+     for(uint32_t f = Job * Chunk; f < Count and f < (Job + 1) * Chunk; f++) {
+        uint16_t* Frame = Frames + 834 * f;
+        float* Out = Direct(Cube) ? Direct(Cube) + 768 * f : Buffer.data() + 768 * Thread;
+        FrameConstants c;
+        Setup(Params, Frame, Emissivity, Tr, c);
+        Fn(c, Frame, Prepared, IL, Conv, Out);
+        Store(Out, Cube + 768 * f);
+        }
+     };
+
+  if (Pool)
+     Pool->Run(Jobs, Job);
+  else
+     for(uint16_t j = 0; j < Jobs; j++)
+        Job(j, 0);
+
+  /* the other subpage's pixels, from the frame before. */
+  for(uint32_t f = 0; f < Count; f++) {
+     const uint16_t* Frame = Frames + 834 * f;
+     T* Out = Cube + 768 * f;
+     for(uint16_t i = 0; i < 768; i++)
+        if (!Active(Frame, i))
+           Out[i] = f ? Out[i - 768] : Missing(Cube);
+     }
+}
+
+void MLX90640Batch::Calculate(uint16_t* Frames, uint32_t Count, float* Cube) {
+  Run(Frames, Count, Cube);
+}
+
+void MLX90640Batch::Calculate(uint16_t* Frames, uint32_t Count, int16_t* Cube) {
+  Run(Frames, Count, Cube);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include "MLX90640_API.h"
+#include "UpScalerSIMD.h"
+#include "UpScalerPool.h"
+
+/*******************************************************************************
+ * MLX90640Batch, To of many recorded raw frames at once, for off-line
+ * re-processing on a host, ie. of archived dumps with another emissivity or
+ * reflected temperature.
+ *
+ * Each frame is converted over all 768 pixels without branches on the
+ * prepared calibration planes, vectorized on AVX2 and aarch64 NEON, and
+ * optionally in parallel. The results equal MLX90640_CalculateToPrepared()
+ * in MLX90640_TO_EXACT mode, on x86 bit for bit.
+ *
+ * The output cube holds 768 pixels per frame. As with successive calls of
+ * MLX90640_CalculateTo() into one image, the pixels not read in a frame's
+ * subpage are those of the frame before; in the first frame they're NAN
+ * (float) or INT16_MIN (int16).
+ ******************************************************************************/
+class MLX90640Batch {
+private:
+  const paramsMLX90640*   Params;
+  const preparedMLX90640* Prepared;
+  UpscalerISA             ISA;
+  UpscalerPool*           Pool;
+  float                   Emissivity;
+  float                   Tr;
+
+  /* ilChess corrections of each pixel, if the frame's mode differs from the
+   * calibration mode: irData + IL[i] - Conv[i].
+   */
+  float IL[768];
+  float Conv[768];
+
+  template<typename T> void Run(uint16_t* Frames, uint32_t Count, T* Cube);
+  bool Active(const uint16_t* Frame, uint16_t Pixel) const;
+
+public:
+  MLX90640Batch(const paramsMLX90640* Params, const preparedMLX90640* Prepared);
+
+  /* default UpscalerBestISA(); SSE4.1 and unsupported ones run Scalar. */
+  void SetISA(UpscalerISA isa);
+
+  /* NULL (default): all frames on the calling thread. */
+  void SetThreadPool(UpscalerPool* Pool);
+
+  /* default 0.95 and NAN, ie. Ta - 8 of each frame as in the sketch. */
+  void SetObject(float Emissivity, float Tr = NAN);
+
+  /* Frames: Count raw frames of 834 words, as from MLX90640_GetFrameData().
+   * Cube:   Count * 768 results in degC or 0.01 degC.
+   */
+  void Calculate(uint16_t* Frames, uint32_t Count, float* Cube);
+  void Calculate(uint16_t* Frames, uint32_t Count, int16_t* Cube);
+};
@@ -0,0 +1,657 @@
+/*******************************************************************************
+ * MLX90640Bench, host accuracy and timing report of the MLX90640 To
+ * conversion modes.
+ *
+ * build (from this folder):
+ *   g++ -O2 -std=c++11 -pthread -I.. MLX90640Bench.cpp SimulatedSensor.cpp ../MLX90640_API.cpp \
+ *       ../MLX90640_I2C_Driver.cpp ../MLX90640Batch.cpp ../MLX90640Cache.cpp ../UpScalerSIMD.cpp \
+ *       ../UpScalerPool.cpp -o MLX90640Bench
+ *
+ * usage:
+ *   MLX90640Bench [file.mrf]
+ *
+ * Converts raw frames, either recorded from a sensor (see
+ * doc/MRF_Fileformat.txt) or made up by SyntheticSensor over a range of
+ * scenes (-30 .. 300 degC, ie. all ct ranges), ambient temperatures and both
+ * readout patterns, with each toConversionMLX90640 mode, on the cached Ta/Vdd
+ * compensation planes (MLX90640_CalculateToCompensated()) and in fixed point
+ * (MLX90640_CalculateToFixed()). Prints the max and mean abs difference to
+ * MLX90640_TO_EXACT in degC and the time per subpage.
+ * Then the same for MLX90640Batch with each available instruction set, single
+ * and multi threaded, against MLX90640_CalculateToPrepared() at emissivity
+ * 0.95 into one running image.
+ * Then MLX90640_ExtractParameters() of a corpus of EEPROMs against the CRCs
+ * of the paramsMLX90640 it gave before the extraction was fused.
+ * Then cold (MLX90640_ExtractParameters()) versus warm (MLX90640Cache) start,
+ * whether the cached calibration comes back bit identical and the peak stack
+ * use of the extraction.
+ * Last, the acquisition through the I2C driver from a SimulatedSensor serving
+ * the frames: the transactions of MLX90640_DumpEE() by burst length, then
+ * per frame of MLX90640_GetFrameData() (busy polling) and
+ * MLX90640_GetFrameDataScheduled() the I2C transactions and status reads,
+ * bus and frame time, the latency from data ready to its detection, and
+ * whether they arrive unchanged. Each frame also asks MLX90640_GetCurMode(),
+ * which the register shadow serves without a transaction; writes are
+ * verified for the configuration registers only, except in the last row.
+ * And the sketch's loop, blocking on each subpage versus the next one
+ * acquired (MLX90640_StartAcquisition()) during the render, on a blocking
+ * bus in steps between strips or in the background as an interrupt or DMA
+ * driven one: the time per loop, the time it waits for the acquisition, the
+ * bus time it spends itself and the subpages skipped, all on the simulated
+ * sensor's clock.
+ *
+ * Exits with 1 if a result that should be bit identical isn't (the batch on
+ * x86, the extraction, the calibration cache), or the simulated sensor's EEPROM or frames
+ * don't come through unchanged.
+ ******************************************************************************/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <cstring>
+#include <pthread.h>
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640Batch.h"
+#include "MLX90640Cache.h"
+#include "SimulatedSensor.h"
+#include "SyntheticSensor.h"
+
+namespace {
+
+struct Frame {
+  uint16_t Data[834];
+  float    Emissivity;
+};
+
+enum class Pipeline { Prepared, Compensated, Fixed };
+
+struct Variant {
+  toConversionMLX90640 Mode;
+  Pipeline             Path;
+  const char*          Name;
+};
+
+const Variant Variants[] = {
+  { MLX90640_TO_EXACT,       Pipeline::Prepared,    "exact"       },
+  { MLX90640_TO_FAST,        Pipeline::Prepared,    "fast"        },
+  { MLX90640_TO_SINGLE_PASS, Pipeline::Prepared,    "single-pass" },
+  { MLX90640_TO_EXACT,       Pipeline::Compensated, "cached"      },
+  { MLX90640_TO_EXACT,       Pipeline::Fixed,       "fixed"       }
+};
+
+struct StackProbe {
+  uint16_t*       ee;
+  paramsMLX90640* Params;
+};
+
+void* ExtractOnProbe(void* Arg) {
+  StackProbe* Probe = (StackProbe*) Arg;
+  if (Probe->ee)
+     MLX90640_ExtractParameters(Probe->ee, Probe->Params);
+  return NULL;
+}
+
+/* bytes of a painted thread stack that were written to, ee NULL: those of
+ * starting the thread alone. Measure after the extraction ran once, as the
+ * dynamic linker's first binding of ldexpf() & co. takes ~3KB by itself.
+ */
+size_t StackUse(uint16_t* ee, paramsMLX90640* Params) {
+  const size_t Size = 64 * 1024;
+  alignas(4096) static uint8_t Stack[Size];
+  StackProbe Probe = { ee, Params };
+  pthread_attr_t Attr;
+  pthread_t Thread;
+
+  memset(Stack, 0xA5, Size);
+  pthread_attr_init(&Attr);
+  pthread_attr_setstack(&Attr, Stack, Size);
+  bool Started = pthread_create(&Thread, &Attr, ExtractOnProbe, &Probe) == 0;
+  pthread_attr_destroy(&Attr);
+  if (!Started)
+     return 0;
+  pthread_join(Thread, NULL);
+
+  size_t Untouched = 0;
+  while (Untouched < Size and Stack[Untouched] == 0xA5)
+     Untouched++;
+  return Size - Untouched;
+}
+
+/* Sensor as the driver's bus, at 800kHz, 16Hz and with frames in one burst. */
+void Attach(SimulatedSensor& Sensor, i2cTransportMLX90640& Bus) {
+  Bus = Sensor.Transport();
+  MLX90640_I2CSetTransport(&Bus);
+  MLX90640_InvalidateShadow(0x33);
+  MLX90640_I2CFreqSet(800);
+  MLX90640_I2CSetBurstLength(1664);
+  MLX90640_SetRefreshRate(0x33, 5);
+}
+
+/* Count frames of a SimulatedSensor serving Recording at 800kHz and 16Hz,
+ * with its clock off by Oscillator, through MLX90640_GetFrameData() or,
+ * Scheduled, MLX90640_GetFrameDataScheduled(), and Work us of processing
+ * after each. Prints the row Name per frame, true if all came unchanged.
+ */
+bool Acquire(const uint16_t* ee, const std::vector<uint16_t>& Recording, uint32_t Count,
+             bool Scheduled, uint32_t Work, float Oscillator, const char* Name) {
+  SimulatedSensor Sensor;
+  Sensor.SetRecording(ee, Recording.data(), Count);
+  Sensor.SetOscillator(Oscillator);
+  i2cTransportMLX90640 Bus;
+  Attach(Sensor, Bus);
+
+  schedulerMLX90640 Scheduler;
+  MLX90640_InitScheduler(0x33, &Scheduler);
+
+  uint32_t Same = 0, StatusReads = 0, Detected = 0, ChessMode = 0;
+  uint64_t Start = 0, Latency = 0;
+  for(uint32_t i = 0; i < Count; i++) {
+     uint16_t Data[834];
+     const uint16_t* Expected = &Recording[i * 834];
+     int SubPage = Scheduled ? MLX90640_GetFrameDataScheduled(&Scheduler, Data) :
+                               MLX90640_GetFrameData(0x33, Data);
+     if (SubPage >= 0 and !memcmp(Data, Expected, 832 * sizeof(uint16_t)) and Data[833] == Expected[833])
+        Same++;
+     /* as a loop that checks the readout mode each time */
+     ChessMode += MLX90640_GetCurMode(0x33) == 1;
+     Sensor.Advance(Work);
+
+     /* per frame from the first one on, which waits for the 2Hz measurement
+      * started before the refresh rate was set.
+      */
+     if (i == 0) {
+        MLX90640_I2CResetStats();
+        Start       = Sensor.Now();
+        StatusReads = Sensor.StatusReads;
+        Detected    = Sensor.Detected;
+        Latency     = Sensor.Latency;
+        }
+     }
+
+  i2cStatsMLX90640 Stats;
+  MLX90640_I2CGetStats(&Stats);
+  MLX90640_I2CSetTransport(NULL);
+
+  double n = Count - 1;
+  printf("%-33s %6.1f %8.1f %8.2f %8.2f %8.2f %6u %5u/%u\n", Name, Stats.transactions / n,
+         (Sensor.StatusReads - StatusReads) / n, Stats.micros / 1e3 / n, (Sensor.Now() - Start) / 1e3 / n,
+         (Sensor.Latency - Latency) / 1e3 / (Sensor.Detected - Detected), Sensor.Missed, Same, Count);
+  return Same == Count and ChessMode == Count;
+}
+
+/* Loops as the sketch's over Recording (Count frames): two subpages with
+ * Compute us of processing each, then the render in Strips strips of Render
+ * us in total. Chunk 0 reads each subpage with
+ * MLX90640_GetFrameDataScheduled(); else the first subpage of the next loop
+ * is acquired during the render, a step of up to Chunk words after each
+ * strip, and completed when it's needed; Background, with reads going on
+ * during the render (SimulatedSensor::SetBackground()). Prints the row Name
+ * per loop, true if all subpages came unchanged.
+ */
+bool Overlap(const uint16_t* ee, const std::vector<uint16_t>& Recording, uint32_t Count,
+             uint16_t Chunk, bool Background, uint32_t Compute, uint32_t Render, int Strips,
+             const char* Name) {
+  SimulatedSensor Sensor;
+  Sensor.SetRecording(ee, Recording.data(), Count);
+  Sensor.SetBackground(Background);
+  i2cTransportMLX90640 Bus;
+  Attach(Sensor, Bus);
+
+  schedulerMLX90640 Scheduler;
+  acquisitionMLX90640 Acquisition;
+  MLX90640_InitScheduler(0x33, &Scheduler);
+  MLX90640_InitAcquisition(&Acquisition, 0x33, &Scheduler, Chunk);
+
+  uint16_t Data[834];
+  const uint32_t Loops = Count / 2;
+  uint32_t Same = 0, Skipped = 0;
+  uint64_t Start = 0, Blocked = 0;
+  for(uint32_t Loop = 0; Loop < Loops; Loop++) {
+     for(int i = 0; i < 2; i++) {
+        uint64_t t = Sensor.Now();
+        int SubPage;
+        if (Chunk == 0)
+           SubPage = MLX90640_GetFrameDataScheduled(&Scheduler, Data);
+        else {
+           /* the first subpage was started before the render */
+           if (i == 1 or Loop == 0)
+              MLX90640_StartAcquisition(&Acquisition, Data);
+           SubPage = MLX90640_CompleteAcquisition(&Acquisition);
+           }
+        if (Loop > 0)
+           Blocked += Sensor.Now() - t;
+
+        /* any of the recorded subpages, some are skipped */
+        for(uint32_t f = 0; f < Count and SubPage >= 0; f++)
+           if (!memcmp(Data, &Recording[f * 834], 832 * sizeof(uint16_t)) and Data[833] == Recording[f * 834 + 833]) {
+              Same++;
+              break;
+              }
+        Sensor.Advance(Compute);
+        }
+
+     if (Chunk)
+        MLX90640_StartAcquisition(&Acquisition, Data);
+     for(int Strip = 0; Strip < Strips; Strip++) {
+        Sensor.Advance(Render / Strips);
+        if (Chunk)
+           MLX90640_PollAcquisition(&Acquisition);
+        }
+
+     /* per loop from the first one on, see Acquire() */
+     if (Loop == 0) {
+        MLX90640_I2CResetStats();
+        Start   = Sensor.Now();
+        Skipped = Scheduler.skipped;
+        }
+     }
+
+  i2cStatsMLX90640 Stats;
+  MLX90640_I2CGetStats(&Stats);
+  MLX90640_I2CSetTransport(NULL);
+
+  double n = Loops - 1;
+  printf("%-33s %8.2f %8.2f %8.2f %7.1f %5u/%u\n", Name, (Sensor.Now() - Start) / 1e3 / n,
+         Blocked / 1e3 / n, Stats.micros / 1e3 / n, (Scheduler.skipped - Skipped) / n, Same, 2 * Loops);
+  return Same == 2 * Loops;
+}
+
+/* MRF, see doc/MRF_Fileformat.txt. */
+bool ReadMRF(const char* Name, uint16_t* ee, std::vector<Frame>& Frames) {
+  FILE* f = fopen(Name, "rb");
+  if (!f)
+     return false;
+
+  char Magic[4];
+  uint16_t Words = 0, Count = 0;
+  bool Ok = fread(Magic, 1, 4, f) == 4 and Magic[0] == 'M' and Magic[1] == 'R' and
+            Magic[2] == 'F' and Magic[3] == 0 and
+            fread(&Words, 2, 1, f) == 1 and Words == 832 and fread(&Count, 2, 1, f) == 1 and
+            fread(ee, 2, 832, f) == 832;
+  for(uint16_t i = 0; Ok and i < Count; i++) {
+     Frame Fr;
+     Fr.Emissivity = 0.95f;
+     Ok = fread(Fr.Data, 2, 834, f) == 834;
+     Frames.push_back(Fr);
+     }
+  fclose(f);
+  return Ok;
+}
+
+void Synthetic(uint16_t* ee, paramsMLX90640* Params, std::vector<Frame>& Frames) {
+  SyntheticSensor Sensor;
+  Sensor.MakeEEPROM(ee);
+  MLX90640_ExtractParameters(ee, Params);
+
+  const float Ambient[]    = { -10.0f, 25.0f, 45.0f };
+  const float Background[] = { -30.0f, 5.0f, 22.0f, 150.0f };
+  const float Hot[]        = { 60.0f, 300.0f };
+  const float Emissivity[] = { 0.95f, 0.65f };
+
+  float To[768];
+  for(float Ta : Ambient)
+     for(float Bg : Background)
+        for(float h : Hot)
+           for(float e : Emissivity) {
+              SyntheticSensor::MakeScene(To, Bg, 13.0f, h);
+              for(int SubPage = 0; SubPage < 4; SubPage++) {
+                 Frame Fr;
+                 Fr.Emissivity = e;
+                 /* Ta drifts by some 0.01 degC between frames */
+                 float Drift = 0.01f * (Frames.size() % 8);
+                 Sensor.MakeFrame(Params, Ta + Drift, To, SubPage & 1, SubPage < 2, e, Ta - 8.0f, Fr.Data);
+                 Frames.push_back(Fr);
+                 }
+              }
+}
+
+/* EEPROM Seed of the extraction corpus: SyntheticSensor's, calibrated in
+ * interleaved mode for odd seeds, with a broken or an outlier pixel for some.
+ * Beyond seed 20 the scales, references and a tenth of the pixel words are
+ * random too, for the rounding and range corners of the extraction.
+ */
+void CorpusEEPROM(uint32_t Seed, uint16_t* ee) {
+  uint32_t r = Seed * 2654435761u;
+  auto Random = [&r](int lo, int hi) {
+     r = r * 1664525u + 1013904223u;
+     return lo + int((r >> 8) % uint32_t(hi - lo + 1));
+     };
+
+  SyntheticSensor Sensor(Seed);
+  int Broken  = Seed % 5 == 0 ? Random(0, 767) : -1;
+  int Outlier = Seed % 7 == 0 ? Random(0, 767) : -1;
+  Sensor.MakeEEPROM(ee, Seed % 2, Broken, Outlier);
+  if (Seed <= 20)
+     return;
+
+  ee[16] = (Random(0, 15) << 12) | (Random(0, 6) << 8) | (Random(0, 6) << 4) | Random(0, 6);
+  ee[17] = Random(0, 0xFFFF);
+  ee[32] = (Random(0, 15) << 12) | (Random(0, 4) << 8) | (Random(0, 4) << 4) | Random(0, 5);
+  ee[33] = Random(0x3000, 0x7FFF);
+  ee[52] = Random(1, 0xFFFF);
+  ee[54] = Random(1, 0xFFFF);
+  ee[55] = Random(0, 0xFFFF);
+  ee[56] = (Random(0, 3) << 12) | (Random(0, 15) << 8) | (Random(0, 15) << 4) | Random(0, 15);
+  ee[57] = (Random(0, 0xFFFF) & 0xFDFF) | 0x0100;
+  ee[58] = Random(0, 0xFFFF);
+  ee[59] = Random(0, 0xFFFF);
+  ee[60] = Random(0, 0xFFFF) & 0xFF3F;
+  for(int p = 0; p < 768; p++)
+     if (Random(0, 9) == 0)
+        ee[64 + p] = (Random(0, 0xFFFF) & 0xFFFE) | (ee[64 + p] & 0x0001) | 0x0002;
+}
+
+/* CRC-32 of the paramsMLX90640 extracted from ee, as MLX90640Cache has it in
+ * its header, and MLX90640_ExtractParameters()' result.
+ */
+uint32_t ExtractionCRC(const uint16_t* ee, int* Result) {
+  static uint16_t Copy[832];
+  static paramsMLX90640 Params;
+  static uint8_t Image[24 + sizeof(paramsMLX90640)];
+  memcpy(Copy, ee, sizeof(Copy));
+  memset(&Params, 0, sizeof(Params));
+  *Result = MLX90640_ExtractParameters(Copy, &Params);
+  MLX90640Cache::Pack(ee + 7, &Params, Image);
+  return Image[20] | (Image[21] << 8) | (Image[22] << 16) | (uint32_t(Image[23]) << 24);
+}
+
+/* the extraction of the corpus before ExtractPixelParameters() fused the
+ * alpha, offset, kta and kv routines: single EEPROMs, and an FNV-1a style hash
+ * of the CRCs and results of seeds 1..ExtractionSeeds. It has to stay bit
+ * identical.
+ */
+struct GoldenExtraction {
+  uint32_t Seed;
+  int      Result;
+  uint32_t CRC;
+};
+
+const GoldenExtraction Golden[] = {
+  {    1, 0, 0x71AF32DC }, {    2, 0, 0x2F02FCD5 }, {    3, 0, 0x8BADF5B3 },
+  {    4, 0, 0x13F5F1E5 }, {    5, 0, 0x5B2C5C08 }, {    6, 0, 0xF96FDAE9 },
+  {    7, 0, 0xD5BC0C5D }, {    8, 0, 0xE4405659 }, {   21, 0, 0x7289CDA5 },
+  {   35, 0, 0x8D641398 }, { 1000, 0, 0x3A20D6E1 },
+};
+const uint32_t ExtractionSeeds = 3000;
+const uint32_t ExtractionHash  = 0x61562D4F;
+
+/* the seeds that don't match Golden[] and ExtractionHash, prints them. */
+uint32_t CheckExtraction(void) {
+  static uint16_t ee[832];
+  uint32_t Failed = 0;
+  int Result;
+
+  for(const GoldenExtraction& g : Golden) {
+     CorpusEEPROM(g.Seed, ee);
+     uint32_t CRC = ExtractionCRC(ee, &Result);
+     if (CRC != g.CRC or Result != g.Result) {
+        printf("  seed %u: CRC %08X result %d, expected %08X %d\n", g.Seed, CRC, Result, g.CRC, g.Result);
+        Failed++;
+        }
+     }
+
+  uint32_t Hash = 2166136261u;
+  for(uint32_t Seed = 1; Seed <= ExtractionSeeds; Seed++) {
+     CorpusEEPROM(Seed, ee);
+     uint32_t CRC = ExtractionCRC(ee, &Result);
+     Hash = (Hash ^ CRC ^ uint32_t(Result)) * 16777619u;
+     }
+  if (Hash != ExtractionHash) {
+     printf("  seeds 1..%u: hash %08X, expected %08X\n", ExtractionSeeds, Hash, ExtractionHash);
+     Failed++;
+     }
+  return Failed;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  static uint16_t ee[832];
+  static paramsMLX90640 Params;
+  static preparedMLX90640 Prepared;
+  std::vector<Frame> Frames;
+
+  if (argc > 1) {
+     if (!ReadMRF(argv[1], ee, Frames)) {
+        fprintf(stderr, "could not read %s\n", argv[1]);
+        return 2;
+        }
+     MLX90640_ExtractParameters(ee, &Params);
+     }
+  else
+     Synthetic(ee, &Params, Frames);
+
+  MLX90640_PrepareParameters(&Params, &Prepared);
+
+  /* reference */
+  std::vector<float> Exact(Frames.size() * 768, NAN);
+  MLX90640_SetToConversion(MLX90640_TO_EXACT);
+  for(size_t i = 0; i < Frames.size(); i++) {
+     frameContextMLX90640 Context;
+     MLX90640_GetFrameContext(Frames[i].Data, &Params, &Context);
+     MLX90640_SetFrameEmissivity(&Context, Frames[i].Emissivity, MLX90640_GetTa(&Context) - 8.0f);
+     MLX90640_CalculateToPrepared(Frames[i].Data, &Params, &Prepared, &Context, &Exact[i * 768]);
+     }
+
+  printf("%zu subpages, %s\n", Frames.size(), argc > 1 ? argv[1] : "synthetic");
+  printf("%-12s %12s %12s %14s %10s\n", "mode", "max err degC", "mean err", "at To degC", "us/subpage");
+
+  static compensatedMLX90640 Compensated;
+  static fixedMLX90640 Fixed;
+  MLX90640_InitCompensation(&Compensated, MLX90640_COMPENSATION_EPSILON_TA,
+                            MLX90640_COMPENSATION_EPSILON_VDD);
+  MLX90640_InitFixed(&Fixed, MLX90640_COMPENSATION_EPSILON_TA, MLX90640_COMPENSATION_EPSILON_VDD);
+
+  for(const Variant& v : Variants) {
+     MLX90640_SetToConversion(v.Mode);
+
+     std::vector<float> Result(Frames.size() * 768, NAN);
+     std::vector<int16_t> Centi(768);
+     double Max = 0, Sum = 0, Worst = 0;
+     uint32_t Count = 0;
+
+     auto t0 = std::chrono::steady_clock::now();
+     for(size_t i = 0; i < Frames.size(); i++) {
+        frameContextMLX90640 Context;
+        MLX90640_GetFrameContext(Frames[i].Data, &Params, &Context);
+        MLX90640_SetFrameEmissivity(&Context, Frames[i].Emissivity, MLX90640_GetTa(&Context) - 8.0f);
+        switch(v.Path) {
+           case Pipeline::Prepared:
+              MLX90640_CalculateToPrepared(Frames[i].Data, &Params, &Prepared, &Context, &Result[i * 768]);
+              break;
+           case Pipeline::Compensated:
+              MLX90640_CalculateToCompensated(Frames[i].Data, &Params, &Prepared, &Compensated, &Context,
+                                              &Result[i * 768]);
+              break;
+           case Pipeline::Fixed:
+              MLX90640_CalculateToFixed(Frames[i].Data, &Params, &Prepared, &Fixed, &Context, Centi.data());
+              for(int p = 0; p < 768; p++)
+                 if (!std::isnan(Exact[i * 768 + p]))
+                    Result[i * 768 + p] = Centi[p] * 0.01f;
+              break;
+           }
+        }
+     double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+     for(size_t i = 0; i < Result.size(); i++) {
+        if (std::isnan(Exact[i]))
+           continue;
+        double Err = fabs(Result[i] - Exact[i]);
+        Sum += Err;
+        Count++;
+        if (Err > Max) {
+           Max   = Err;
+           Worst = Exact[i];
+           }
+        }
+
+     printf("%-12s %12.5f %12.6f %14.1f %10.1f\n", v.Name, Max, Count ? Sum / Count : 0.0,
+            Worst, t * 1e6 / Frames.size());
+     }
+  printf("cached: %u rebuilds of the compensation planes in %u frames, fixed: %u in %u\n",
+         Compensated.rebuilds, Compensated.updates, Fixed.rebuilds, Fixed.updates);
+
+  /* batch: all frames as one uint16_t cube, the reference per frame. */
+  std::vector<uint16_t> Raw(Frames.size() * 834);
+  for(size_t i = 0; i < Frames.size(); i++)
+     memcpy(&Raw[i * 834], Frames[i].Data, sizeof(Frames[i].Data));
+
+  MLX90640_SetToConversion(MLX90640_TO_EXACT);
+  std::vector<float> Reference(Frames.size() * 768);
+  std::vector<float> Image(768, NAN);
+  for(size_t i = 0; i < Frames.size(); i++) {
+     frameContextMLX90640 Context;
+     MLX90640_GetFrameContext(Frames[i].Data, &Params, &Context);
+     MLX90640_SetFrameEmissivity(&Context, 0.95f, MLX90640_GetTa(&Context) - 8.0f);
+     MLX90640_CalculateToPrepared(Frames[i].Data, &Params, &Prepared, &Context, Image.data());
+     memcpy(&Reference[i * 768], Image.data(), 768 * sizeof(float));
+     }
+
+  UpscalerPool Pool;
+  MLX90640Batch Batch(&Params, &Prepared);
+  std::vector<float> Cube(Frames.size() * 768);
+  printf("\n%-16s %12s %12s %10s\n", "batch", "max err degC", "differing", "us/subpage");
+  bool BatchOk = true;
+
+  for(UpscalerISA isa : { UpscalerISA::Scalar, UpscalerISA::AVX2, UpscalerISA::NEON }) {
+     if (!UpscalerHasISA(isa))
+        continue;
+     for(int Threaded = 0; Threaded < 2; Threaded++) {
+        Batch.SetISA(isa);
+        Batch.SetThreadPool(Threaded ? &Pool : NULL);
+
+        auto t0 = std::chrono::steady_clock::now();
+        Batch.Calculate(Raw.data(), Frames.size(), Cube.data());
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        double Max = 0;
+        uint32_t Differing = 0;
+        for(size_t i = 0; i < Cube.size(); i++) {
+           if (std::isnan(Reference[i]) and std::isnan(Cube[i]))
+              continue;
+           if (memcmp(&Reference[i], &Cube[i], sizeof(float)))
+              Differing++;
+           Max = fmax(Max, fabs(Reference[i] - Cube[i]));
+           }
+
+        char Name[32];
+        snprintf(Name, sizeof(Name), "%s x%d", UpscalerISAName(isa), Threaded ? Pool.Threads() : 1);
+        printf("%-16s %12.5f %12u %10.1f\n", Name, Max, Differing, t * 1e6 / Frames.size());
+#if defined(__x86_64__) || defined(__i386__)
+        /* bit for bit on x86, see MLX90640Batch.h */
+        BatchOk = BatchOk and Differing == 0;
+#endif
+        }
+     }
+
+  /* extraction against the golden corpus */
+  printf("\nextraction: %u corpus EEPROMs\n", ExtractionSeeds);
+  bool ExtractionOk = CheckExtraction() == 0;
+  printf("  bit identical to the golden CRCs: %s\n", ExtractionOk ? "yes" : "no");
+
+  /* calibration cache, in the current directory. */
+  const char* CacheFile = "MLX90640Bench.cal";
+  const int Starts = 20;
+  MLX90640Cache Cache(CacheFile);
+  static paramsMLX90640 Cold, Warm;
+  memset(&Cold, 0, sizeof(Cold));
+  memset(&Warm, 0xA5, sizeof(Warm));
+
+  auto t0 = std::chrono::steady_clock::now();
+  for(int i = 0; i < Starts; i++)
+     MLX90640_ExtractParameters(ee, &Cold);
+  double tCold = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / Starts;
+
+  bool Saved = Cache.Save(ee + 7, &Cold);
+  bool Loaded = true;
+  t0 = std::chrono::steady_clock::now();
+  for(int i = 0; i < Starts; i++)
+     Loaded = Loaded and Cache.Load(ee + 7, &Warm);
+  double tWarm = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / Starts;
+
+  uint16_t Other[3] = { ee[7], ee[8], uint16_t(ee[9] ^ 1) };
+  bool OtherSensor = Cache.Load(Other, &Warm);
+
+  std::vector<uint8_t> Packed(MLX90640Cache::Size());
+  MLX90640Cache::Pack(ee + 7, &Cold, Packed.data());
+  Packed[Packed.size() / 2] ^= 0x10;
+  bool Damaged = MLX90640Cache::Unpack(Packed.data(), Packed.size(), ee + 7, &Warm);
+  remove(CacheFile);
+
+  /* 832 words at 800kHz, 9 clocks per byte: about 19ms, plus the extraction. */
+  printf("\ncalibration cache: %u bytes, saved %s, loaded %s, bit identical %s\n",
+         MLX90640Cache::Size(), Saved ? "yes" : "no", Loaded ? "yes" : "no",
+         memcmp(&Cold, &Warm, sizeof(Cold)) ? "no" : "yes");
+  printf("  cold start: extraction %8.1f us (+ ~%.1f ms EEPROM dump at 800kHz)\n",
+         tCold * 1e6, 832 * 2 * 9 / 800.0);
+  printf("  warm start: cache load %8.1f us (+ 3 word device id read)\n", tWarm * 1e6);
+  printf("  rejected: other sensor %s, damaged %s\n", OtherSensor ? "no" : "yes",
+         Damaged ? "no" : "yes");
+  printf("  extraction peak stack: %u bytes (host, %s)\n",
+         unsigned(StackUse(ee, &Cold) - StackUse(NULL, &Cold)), sizeof(void*) == 8 ? "64 bit" : "32 bit");
+  bool CacheOk = Saved and Loaded and !OtherSensor and !Damaged and !memcmp(&Cold, &Warm, sizeof(Cold));
+
+  /* acquisition at 800kHz and 16Hz, ie. with time to read every subpage. */
+  const uint32_t Acquired = Frames.size() < 64 ? Frames.size() : 64;
+  std::vector<uint16_t> Recording;
+  for(uint32_t i = 0; i < Acquired; i++)
+     Recording.insert(Recording.end(), Frames[i].Data, Frames[i].Data + 834);
+
+  SimulatedSensor Sensor;
+  Sensor.SetRecording(ee, Recording.data(), Acquired);
+  i2cTransportMLX90640 Bus = Sensor.Transport();
+  MLX90640_I2CSetTransport(&Bus);
+  MLX90640_I2CFreqSet(800);
+  MLX90640_SetRefreshRate(0x33, 5);
+
+  /* burst length: address phases and bus time of the 832 word EEPROM dump */
+  static uint16_t Dumped[832];
+  bool SameEEPROM = true;
+  i2cStatsMLX90640 Stats;
+  printf("\n%-16s %12s %12s %10s\n", "I2C burst bytes", "transactions", "bytes", "bus us");
+  for(unsigned int Burst : { 32u, 128u, 1664u }) {
+     MLX90640_I2CSetBurstLength(Burst);
+     MLX90640_I2CResetStats();
+     SameEEPROM = SameEEPROM and MLX90640_DumpEE(0x33, Dumped) == 0 and
+                  !memcmp(Dumped, ee, sizeof(Dumped));
+     MLX90640_I2CGetStats(&Stats);
+     printf("%-16u %12u %12u %10u\n", Burst, Stats.transactions, Stats.bytes, Stats.micros);
+     }
+
+  MLX90640_I2CSetTransport(NULL);
+
+  /* frames, busy polling versus scheduled, with and without some processing
+   * (ie. upscaling) after each.
+   */
+  printf("\nacquisition (simulated sensor, 800kHz, 16Hz): EEPROM %s\n", SameEEPROM ? "identical" : "differs");
+  printf("%-33s %6s %8s %8s %8s %8s %6s %9s\n", "", "I2C", "status", "I2C", "frame", "latency",
+         "missed", "unchanged");
+  printf("%-33s %6s %8s %8s %8s %8s\n", "", "trans.", "reads", "ms", "ms", "ms");
+  bool SameFrames = true;
+  SameFrames = Acquire(ee, Recording, Acquired, false, 0, 0.0f, "busy polling") and SameFrames;
+  SameFrames = Acquire(ee, Recording, Acquired, false, 20000, 0.0f, "busy polling, 20ms work") and SameFrames;
+  SameFrames = Acquire(ee, Recording, Acquired, true, 0, 0.0f, "scheduled") and SameFrames;
+  SameFrames = Acquire(ee, Recording, Acquired, true, 20000, 0.0f, "scheduled, 20ms work") and SameFrames;
+  SameFrames = Acquire(ee, Recording, Acquired, true, 20000, 0.02f, "scheduled, 20ms work, clock +2%") and SameFrames;
+  SameFrames = Acquire(ee, Recording, Acquired, true, 20000, -0.02f, "scheduled, 20ms work, clock -2%") and SameFrames;
+  MLX90640_I2CSetWriteVerify(MLX90640_VERIFY_ALWAYS);
+  SameFrames = Acquire(ee, Recording, Acquired, true, 20000, 0.0f, "scheduled, 20ms work, verify all") and SameFrames;
+  MLX90640_I2CSetWriteVerify(MLX90640_VERIFY_CONFIG);
+
+  /* loops of two subpages with 3ms processing each and a render in 6 strips,
+   * as the sketch's with the 320x240 display. With 90ms it takes more than a
+   * frame unless the bus works meanwhile.
+   */
+  for(uint32_t Render : { 40000u, 90000u }) {
+     printf("\nrender overlap (16Hz, 2 subpages per loop, 2 x 3ms + %ums work)\n", Render / 1000);
+     printf("%-33s %8s %8s %8s %7s %9s\n", "", "loop", "blocked", "I2C", "skipped", "unchanged");
+     printf("%-33s %8s %8s %8s\n", "", "ms", "ms", "ms");
+     SameFrames = Overlap(ee, Recording, Acquired, 0, false, 3000, Render, 6, "scheduled") and SameFrames;
+     SameFrames = Overlap(ee, Recording, Acquired, 208, false, 3000, Render, 6,
+                          "during render, 208 words") and SameFrames;
+     SameFrames = Overlap(ee, Recording, Acquired, 832, true, 3000, Render, 6,
+                          "background, 832 words") and SameFrames;
+     }
+  return !(BatchOk and ExtractionOk and CacheOk and SameEEPROM and SameFrames);
+}
@@ -0,0 +1,186 @@
+#include "SimulatedSensor.h"
+#include <cstring>
+
+namespace {
+
+/* start, address + R/W and ack, 2 register address bytes; a read adds the
+ * repeated start and address, both add 9 bits per byte and the stop.
+ */
+const uint32_t ReadBits  = 1 + 9 + 18 + 1 + 9 + 1;
+const uint32_t WriteBits = 1 + 9 + 18 + 18 + 1;
+
+} // namespace
+
+SimulatedSensor::SimulatedSensor(uint8_t Address, uint32_t Seed)
+  : Address(Address), Synthetic(Seed), Scene(768), Ta(25.0f), Emissivity(0.95f), Tr(NAN),
+    Noise(3), Recorded(0), NextRecorded(0), Frequency(100000), Oscillator(1.0f), Clock(0), BusFree(0),
+    Background(false),
+    ReadyAt(0), Seen(false), SubPage(0), Reads(0), Writes(0), Nacks(0), StatusReads(0), WordsRead(0), BusTime(0),
+    Measured(0), Missed(0), Detected(0), Latency(0) {
+  memset(RAM, 0, sizeof(RAM));
+  memset(Registers, 0, sizeof(Registers));
+  Registers[0x0D] = 0x1901;
+
+  Synthetic.MakeEEPROM(EEPROM);
+  MLX90640_ExtractParameters(EEPROM, &Params);
+  SyntheticSensor::MakeScene(Scene.data());
+  NextMeasurement = Period();
+}
+
+void SimulatedSensor::SetRecording(const uint16_t* ee, const uint16_t* Frames, uint32_t Count) {
+  memcpy(EEPROM, ee, sizeof(EEPROM));
+  MLX90640_ExtractParameters(EEPROM, &Params);
+  Recording.assign(Frames, Frames + Count * 834);
+  Recorded     = Count;
+  NextRecorded = 0;
+  if (Count)
+     Registers[0x0D] = Frames[832];
+}
+
+void SimulatedSensor::SetScene(const float* To, float Ta, float Emissivity, float Tr, int Noise) {
+  Scene.assign(To, To + 768);
+  this->Ta         = Ta;
+  this->Emissivity = Emissivity;
+  this->Tr         = Tr;
+  this->Noise      = Noise;
+  Recorded         = 0;
+}
+
+uint32_t SimulatedSensor::Period(void) const {
+  /* 0.5Hz * 2^rate subpages */
+  return 2000000 >> ((Registers[0x0D] >> 7) & 0x07);
+}
+
+void SimulatedSensor::Advance(uint64_t us) {
+  Clock += us;
+  Update();
+}
+
+void SimulatedSensor::Update(void) {
+  while (Clock >= NextMeasurement) {
+     Measure(NextMeasurement);
+     NextMeasurement += uint64_t(Period() * Oscillator);
+     }
+}
+
+void SimulatedSensor::Measure(uint64_t At) {
+  uint16_t Frame[834];
+  uint16_t& Status = Registers[0x00];
+
+  if (Recorded) {
+     memcpy(Frame, &Recording[NextRecorded * 834], sizeof(Frame));
+     NextRecorded = (NextRecorded + 1) % Recorded;
+     SubPage = Frame[833] & 0x0001;
+     }
+  else
+     Synthetic.MakeFrame(&Params, Ta, Scene.data(), SubPage, Registers[0x0D] & 0x1000, Emissivity,
+                         std::isnan(Tr) ? Ta - 8.0f : Tr, Frame, Noise);
+
+  Measured++;
+  bool Unread = Status & 0x0008;
+  if (Unread)
+     Missed++;
+  if (!Unread or (Status & 0x0010)) {
+     memcpy(RAM, Frame, sizeof(RAM));
+     Status  = (Status & 0xFFF0) | 0x0008 | SubPage;
+     ReadyAt = At;
+     Seen    = false;
+     }
+
+  /* subpage mode alternates, else it's always subpage 0 */
+  SubPage = (Registers[0x0D] & 0x0001) ? SubPage ^ 1 : 0;
+}
+
+void SimulatedSensor::Transfer(uint32_t Bits, bool InBackground) {
+  uint64_t t = (uint64_t(Bits) * 1000000 + Frequency - 1) / Frequency;
+  BusTime += t;
+  if (InBackground)
+     BusFree = Clock + t;
+  else {
+     Clock += t;
+     Update();
+     }
+}
+
+void SimulatedSensor::WaitForBus(void) {
+  if (BusFree > Clock)
+     Advance(BusFree - Clock);
+}
+
+uint16_t SimulatedSensor::Word(unsigned int Address) {
+  if (Address >= 0x0400 and Address < 0x0400 + 832)
+     return RAM[Address - 0x0400];
+  if (Address >= 0x2400 and Address < 0x2400 + 832)
+     return EEPROM[Address - 0x2400];
+  if (Address >= 0x8000 and Address < 0x8000 + 0x20)
+     return Registers[Address - 0x8000];
+  return 0;
+}
+
+int SimulatedSensor::Read(void* Context, uint8_t SlaveAddr, unsigned int StartAddress,
+                          unsigned int Words, uint16_t* Data) {
+  SimulatedSensor* s = (SimulatedSensor*) Context;
+  s->WaitForBus();
+  if (SlaveAddr != s->Address) {
+     s->Nacks++;
+     s->Transfer(1 + 9 + 1);
+     return -1;
+     }
+
+  /* the RAM is read as it is at the start, the next subpage may be measured
+   * during the transfer.
+   */
+  s->Update();
+  for(unsigned int i = 0; i < Words; i++)
+     Data[i] = s->Word(StartAddress + i);
+  if (StartAddress <= 0x8000 and StartAddress + Words > 0x8000) {
+     s->StatusReads++;
+     if ((s->Registers[0x00] & 0x0008) and !s->Seen) {
+        s->Seen = true;
+        s->Detected++;
+        s->Latency += s->Clock - s->ReadyAt;
+        }
+     }
+  s->Reads++;
+  s->WordsRead += Words;
+  s->Transfer(ReadBits + 18 * Words, s->Background and Words > 1);
+  return 0;
+}
+
+int SimulatedSensor::Write(void* Context, uint8_t SlaveAddr, unsigned int Address, uint16_t Data) {
+  SimulatedSensor* s = (SimulatedSensor*) Context;
+  s->WaitForBus();
+  if (SlaveAddr != s->Address or Address < 0x8000 or Address >= 0x8000 + 0x20) {
+     s->Nacks++;
+     s->Transfer(1 + 9 + 1);
+     return -1;
+     }
+
+  s->Update();
+  uint16_t& Register = s->Registers[Address - 0x8000];
+  if (Address == 0x8000)
+     /* subpage bits are read only, data ready can only be cleared */
+     Register = (Register & 0x0007) | (Register & Data & 0x0008) | (Data & 0xFFF0);
+  else
+     Register = Data;
+  s->Writes++;
+  s->Transfer(WriteBits);
+  return 0;
+}
+
+void SimulatedSensor::FreqSet(void* Context, int kHz) {
+  ((SimulatedSensor*) Context)->Frequency = kHz * 1000;
+}
+
+unsigned long SimulatedSensor::Micros(void* Context) {
+  return ((SimulatedSensor*) Context)->Clock;
+}
+
+void SimulatedSensor::Delay(void* Context, unsigned long us) {
+  ((SimulatedSensor*) Context)->Advance(us);
+}
+
+i2cTransportMLX90640 SimulatedSensor::Transport(void) {
+  i2cTransportMLX90640 t = { Read, Write, FreqSet, Micros, Delay, this };
+  return t;
+}
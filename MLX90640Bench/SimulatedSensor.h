@@ -0,0 +1,119 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "SyntheticSensor.h"
+
+/*******************************************************************************
+ * SimulatedSensor, an MLX90640 on a virtual I2C bus for host builds. Set as
+ * the I2C transport, MLX90640_API.cpp talks to it as to a sensor on Wire:
+ *
+ *   SimulatedSensor Sensor;
+ *   i2cTransportMLX90640 Bus = Sensor.Transport();
+ *   MLX90640_I2CSetTransport(&Bus);
+ *
+ * It models the address ranges the driver uses:
+ *   0x0400..0x073F  RAM, the 768 pixels and 64 auxiliary words
+ *   0x2400..0x273F  EEPROM, read only
+ *   0x8000          status: last measured subpage (bits 0..2), data ready
+ *                   (bit 3, cleared by writing 0 to it), overwrite enable
+ *                   (bit 4)
+ *   0x800D          control 1: subpage mode (bit 0), refresh rate (7..9),
+ *                   resolution (10..11), chess mode (12)
+ * and time, as a virtual clock in us, which is also the driver's
+ * MLX90640_I2CMicros() and MLX90640_I2CDelay(). Each transaction advances it
+ * by its bits at the bus frequency; every 1 / refresh rate a subpage is
+ * measured. With SetBackground(), reads of more than one word return at once
+ * and go on while the caller does, as with an interrupt or DMA driven bus.
+ * It comes from a recording (see doc/MRF_Fileformat.txt) or from
+ * SyntheticSensor looking at a scene, and goes to RAM unless data ready is
+ * still set and overwrite is disabled.
+ ******************************************************************************/
+class SimulatedSensor {
+private:
+  uint8_t  Address;
+  uint16_t EEPROM[832];
+  uint16_t RAM[832];
+  uint16_t Registers[0x20];   // 0x8000..
+  paramsMLX90640 Params;
+
+  SyntheticSensor       Synthetic;
+  std::vector<float>    Scene;
+  float                 Ta, Emissivity, Tr;
+  int                   Noise;
+  std::vector<uint16_t> Recording;
+  uint32_t              Recorded, NextRecorded;
+
+  uint32_t Frequency;
+  float    Oscillator;
+  uint64_t Clock;
+  uint64_t BusFree;          // end of the background read
+  bool     Background;
+  uint64_t NextMeasurement;
+  uint64_t ReadyAt;
+  bool     Seen;
+  int      SubPage;
+
+  void Update(void);
+  void Measure(uint64_t At);
+  void WaitForBus(void);
+  void Transfer(uint32_t Bits, bool InBackground = false);
+  uint16_t Word(unsigned int Address);
+
+  static int Read(void* Context, uint8_t SlaveAddr, unsigned int StartAddress,
+                  unsigned int Words, uint16_t* Data);
+  static int Write(void* Context, uint8_t SlaveAddr, unsigned int Address, uint16_t Data);
+  static void FreqSet(void* Context, int kHz);
+  static unsigned long Micros(void* Context);
+  static void Delay(void* Context, unsigned long us);
+
+public:
+  /* bus statistics since construction */
+  uint32_t Reads, Writes, Nacks;
+  uint32_t StatusReads;      // reads of 0x8000
+  uint64_t WordsRead;
+  uint64_t BusTime;          // us
+  uint32_t Measured;         // subpages
+  uint32_t Missed;           // thereof not read before the next one
+  uint32_t Detected;         // thereof seen by a status read
+  uint64_t Latency;          // us from measurement to those status reads, sum
+
+  /* a SyntheticSensor EEPROM (Seed), 2Hz, 18 bit, chess mode as shipped,
+   * looking at SyntheticSensor::MakeScene() at Ta 25 degC.
+   */
+  explicit SimulatedSensor(uint8_t Address = 0x33, uint32_t Seed = 1);
+
+  /* calibration and frames of a recording: 832 EEPROM words and Count frames
+   * of 834 words, served in a loop. Control 1 becomes the one recorded with
+   * the first frame.
+   */
+  void SetRecording(const uint16_t* ee, const uint16_t* Frames, uint32_t Count);
+
+  /* synthetic frames of To[768] (degC) */
+  void SetScene(const float* To, float Ta, float Emissivity = 0.95f, float Tr = NAN, int Noise = 3);
+
+  i2cTransportMLX90640 Transport(void);
+
+  const paramsMLX90640* Calibration(void) const { return &Params; }
+
+  /* the virtual clock, us. Advance() lets time pass outside of the bus,
+   * ie. for the host's processing or sleeping.
+   */
+  uint64_t Now(void) const { return Clock; }
+  void Advance(uint64_t us);
+
+  /* of a subpage at the current refresh rate */
+  uint32_t Period(void) const;
+
+  /* the sensor's clock error, ie. 0.02: subpages come 2% slower than the
+   * refresh rate says. Default 0.
+   */
+  void SetOscillator(float Error) { Oscillator = 1.0f + Error; }
+
+  /* reads of more than one word in the background: the next transaction
+   * waits for the one before, the caller's clock doesn't. Default false.
+   */
+  void SetBackground(bool On) { Background = On; }
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "MLX90640_API.h"
+
+/*******************************************************************************
+ * SyntheticSensor, plausible MLX90640 EEPROM contents and raw frames for host
+ * tools, when no recording of a real sensor is at hand.
+ *
+ * MakeEEPROM() fills the calibration words with values in the ranges of real
+ * parts, MakeFrame() inverts the To calculation, so that a frame read back
+ * through MLX90640_CalculateTo() gives about the requested scene (within a
+ * few 0.1K, as Sx and the ct ranges aren't inverted).
+ ******************************************************************************/
+class SyntheticSensor {
+private:
+  uint32_t Seed;
+
+  int Random(int lo, int hi) {
+     Seed = Seed * 1103515245u + 12345u;
+     return lo + int((Seed >> 8) % uint32_t(hi - lo + 1));
+     }
+
+  static uint16_t Bits(int Value, int Width) {
+     return uint16_t(Value) & ((1 << Width) - 1);
+     }
+public:
+  SyntheticSensor(uint32_t Seed = 1) : Seed(Seed) {}
+
+  /* calibrated in chess mode, unless InterleavedCalibration.
+   * Broken, Outlier: pixel to flag as such, -1: none.
+   */
+  void MakeEEPROM(uint16_t* ee, bool InterleavedCalibration = false, int Broken = -1, int Outlier = -1) {
+     memset(ee, 0, 832 * sizeof(uint16_t));
+     ee[7]  = 0x1234; // device id
+     ee[8]  = 0x5678;
+     ee[9]  = 0x9ABC;
+     ee[10] = InterleavedCalibration ? 0x0800 : 0x0000;
+
+     // offsets: alphaPTAT, row/column/remainder scales, reference, row and column
+     ee[16] = (0x4 << 12) | (0x4 << 8) | (0x4 << 4) | 0x2;
+     ee[17] = Bits(-80, 16);
+     for(int i = 18; i < 32; i++)
+        ee[i] = Random(0, 0xFFFF);
+
+     // sensitivities: scales, reference, row and column
+     ee[32] = (0x4 << 12) | (0x3 << 8) | (0x3 << 4) | 0x2;
+     ee[33] = 0x5A00;
+     for(int i = 34; i < 48; i++)
+        ee[i] = Random(0, 0x7777) & 0x7777;
+
+     ee[48] = 5580;                                  // gain
+     ee[49] = 12273;                                 // vPTAT25
+     ee[50] = (22 << 10) | 336;                      // KvPTAT, KtPTAT
+     ee[51] = (Bits(-99, 8) << 8) | 154;             // kVdd, vdd25
+     ee[52] = 0x5454;                                // kv
+     ee[53] = (5 << 11) | (4 << 6) | 1;              // IL/chess corrections
+     ee[54] = (0x60 << 8) | 0x58;                    // kta
+     ee[55] = (0x5C << 8) | 0x55;
+     ee[56] = (0x2 << 12) | (0x3 << 8) | (0x5 << 4) | 0x2; // resolution, kv and kta scales
+     ee[57] = (0x10 << 10) | 0x1C0;                  // CP alpha
+     ee[58] = (0x2 << 10) | Bits(-75, 10);           // CP offset
+     ee[59] = (0x40 << 8) | 0x10;                    // CP kv, kta
+     ee[60] = (Bits(-16, 8) << 8) | 0x20;            // KsTa, tgc
+     ee[61] = (Bits(-0x20, 8) << 8) | Bits(-0x22, 8); // ksTo
+     ee[62] = (Bits(-0x21, 8) << 8) | Bits(-0x23, 8);
+     ee[63] = (0x2 << 12) | (0xA << 8) | (0x6 << 4) | 0x9; // ct step, ct3, ct2, ksTo scale
+
+     for(int p = 0; p < 768; p++) {
+        int Offset = Random(-20, 20), Alpha = Random(-15, 15), Kta = Random(-3, 3);
+        ee[64 + p] = (Bits(Offset, 6) << 10) | (Bits(Alpha, 6) << 4) | (Bits(Kta, 3) << 1);
+        if (!ee[64 + p])
+           ee[64 + p] = 0x0400; // 0 means broken
+        }
+     if (Broken >= 0)
+        ee[64 + Broken] = 0;
+     if (Outlier >= 0)
+        ee[64 + Outlier] |= 1;
+     }
+
+  /* raw frame (834 words) of SubPage in chess or interleaved mode, for a
+   * sensor at Ta, Vdd 3.3V, looking at To[] (768 degC) with Emissivity and
+   * reflected temperature Tr. Noise: +/- raw counts.
+   * Pixels of the other subpage hold slightly different, stale values.
+   */
+  void MakeFrame(const paramsMLX90640* p, float Ta, const float* To, int SubPage, bool Chess,
+                 float Emissivity, float Tr, uint16_t* Frame, int Noise = 3) {
+     memset(Frame, 0, 834 * sizeof(uint16_t));
+     Frame[832] = (Chess ? 0x1000 : 0) | (p->resolutionEE << 10);
+     Frame[833] = SubPage;
+     Frame[810] = uint16_t(p->vdd25);
+     Frame[778] = uint16_t(p->gainEE);
+
+     int16_t Ptat    = 1700;
+     float   PtatArt = p->vPTAT25 + (Ta - 25.0f) * p->KtPTAT;
+     Frame[800] = Ptat;
+     Frame[768] = uint16_t(int16_t(lrintf(Ptat * 262144.0f / PtatArt - Ptat * p->alphaPTAT)));
+
+     const float CP[2] = { 3.0f, -2.0f };
+     float CPTa = 1.0f + p->cpKta * (Ta - 25.0f);
+     Frame[776] = uint16_t(int16_t(lrintf(p->cpOffset[0] * CPTa + CP[0])));
+     Frame[808] = uint16_t(int16_t(lrintf(p->cpOffset[1] * CPTa + CP[1])));
+
+     float Ta4  = powf(Ta + 273.15f, 4.0f);
+     float Tr4  = powf(Tr + 273.15f, 4.0f);
+     float TaTr = Tr4 - (Tr4 - Ta4) / Emissivity;
+     uint8_t Mode = Chess ? 0x80 : 0;
+
+     for(int i = 0; i < 768; i++) {
+        int IL    = (i >> 5) & 1;
+        int Pixel = Chess ? IL ^ (i & 1) : IL;
+        int Conversion = ((i + 2) / 4 - (i + 3) / 4 + (i + 1) / 4 - i / 4) * (1 - 2 * IL);
+
+        float Alpha = float(SCALEALPHA * ldexp(1.0, p->alphaScale) / p->alpha[i]) *
+                      (1.0f + p->KsTa * (Ta - 25.0f));
+        float Kta   = ldexpf(p->kta[i], -p->ktaScale);
+        float ir    = Alpha * (powf(To[i] + 273.15f, 4.0f) - TaTr) * Emissivity;
+
+        ir += p->offset[i] * (1.0f + Kta * (Ta - 25.0f));
+        if (Mode != p->calibrationModeEE)
+           ir -= p->ilChessC[2] * (2 * IL - 1) - p->ilChessC[1] * Conversion;
+        ir += p->tgc * CP[SubPage];
+
+        int Value = lrintf(ir) + (Noise ? Random(-Noise, Noise) : 0);
+        Frame[i] = uint16_t(int16_t(Pixel == SubPage ? Value : Value + 7));
+        }
+     }
+
+  /* a room temperature background with a warm blob (Warm degC above
+   * Background) and a small hot spot at Hot degC.
+   */
+  static void MakeScene(float* To, float Background = 22.0f, float Warm = 13.0f, float Hot = 80.0f) {
+     for(int i = 0; i < 768; i++) {
+        float x = i % 32, y = i / 32;
+        float dx = x - 12.0f, dy = y - 12.0f, hx = x - 25.0f, hy = y - 5.0f;
+        To[i] = Background + 0.05f * y +
+                Warm * expf(-(dx * dx + dy * dy) / 30.0f) +
+                (Hot - Background) * expf(-(hx * hx + hy * hy) / 3.0f);
+        }
+     }
+};
@@ -0,0 +1,127 @@
+#include "MLX90640Cache.h"
+#include <cstring>
+#include <vector>
+#include "MLX90640_I2C_Driver.h"
+
+#ifndef ARDUINO
+   #include <cstdio>
+#endif
+
+namespace {
+
+const uint32_t HeaderSize = 24;
+
+/* CRC-32, polynomial 0xEDB88320 as in zip and png. */
+uint32_t CRC32(const uint8_t* Data, uint32_t Length) {
+  uint32_t crc = 0xFFFFFFFF;
+  while(Length--) {
+     crc ^= *Data++;
+     for(int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+     }
+  return ~crc;
+}
+
+void Put16(uint8_t* p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+void Put32(uint8_t* p, uint32_t v) {
+  Put16(p, v);
+  Put16(p + 2, v >> 16);
+}
+
+uint16_t Get16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+uint32_t Get32(const uint8_t* p) {
+  return Get16(p) | ((uint32_t) Get16(p + 2) << 16);
+}
+
+} // namespace
+
+uint32_t MLX90640Cache::Size(void) {
+  return HeaderSize + sizeof(paramsMLX90640);
+}
+
+int MLX90640Cache::DeviceId(uint8_t SlaveAddr, uint16_t* DeviceId) {
+  return MLX90640_I2CRead(SlaveAddr, 0x2407, 3, DeviceId);
+}
+
+void MLX90640Cache::Pack(const uint16_t* DeviceId, const paramsMLX90640* Params, uint8_t* Image) {
+  memcpy(Image, "MLXC", 4);
+  Put16(Image +  4, Version);
+  Put16(Image +  6, 0);
+  Put32(Image +  8, sizeof(paramsMLX90640));
+  Put16(Image + 12, DeviceId[0]);
+  Put16(Image + 14, DeviceId[1]);
+  Put16(Image + 16, DeviceId[2]);
+  Put16(Image + 18, 0);
+  memcpy(Image + HeaderSize, Params, sizeof(paramsMLX90640));
+  Put32(Image + 20, CRC32(Image + HeaderSize, sizeof(paramsMLX90640)));
+}
+
+bool MLX90640Cache::Unpack(const uint8_t* Image, uint32_t Length, const uint16_t* DeviceId,
+                           paramsMLX90640* Params) {
+  if (Length != Size() or memcmp(Image, "MLXC", 4) or
+      Get16(Image +  4) != Version or
+      Get32(Image +  8) != sizeof(paramsMLX90640) or
+      Get16(Image + 12) != DeviceId[0] or
+      Get16(Image + 14) != DeviceId[1] or
+      Get16(Image + 16) != DeviceId[2] or
+      Get32(Image + 20) != CRC32(Image + HeaderSize, sizeof(paramsMLX90640)))
+     return false;
+
+  memcpy(Params, Image + HeaderSize, sizeof(paramsMLX90640));
+  return true;
+}
+
+#ifdef ARDUINO
+bool MLX90640Cache::Load(const uint16_t* DeviceId, paramsMLX90640* Params) {
+  File fd = Fs.open(Path, FILE_READ);
+  if (!fd)
+     return false;
+
+  std::vector<uint8_t> Image(Size());
+  uint32_t Length = fd.read(Image.data(), Image.size());
+  bool Extra = fd.available() > 0;
+  fd.close();
+  return !Extra and Unpack(Image.data(), Length, DeviceId, Params);
+}
+
+bool MLX90640Cache::Save(const uint16_t* DeviceId, const paramsMLX90640* Params) {
+  std::vector<uint8_t> Image(Size());
+  Pack(DeviceId, Params, Image.data());
+
+  File fd = Fs.open(Path, FILE_WRITE);
+  if (!fd)
+     return false;
+  bool Ok = fd.write(Image.data(), Image.size()) == Image.size();
+  fd.close();
+  return Ok;
+}
+#else
+bool MLX90640Cache::Load(const uint16_t* DeviceId, paramsMLX90640* Params) {
+  FILE* fd = fopen(Path, "rb");
+  if (!fd)
+     return false;
+
+  std::vector<uint8_t> Image(Size() + 1);
+  uint32_t Length = fread(Image.data(), 1, Image.size(), fd);
+  fclose(fd);
+  return Unpack(Image.data(), Length, DeviceId, Params);
+}
+
+bool MLX90640Cache::Save(const uint16_t* DeviceId, const paramsMLX90640* Params) {
+  std::vector<uint8_t> Image(Size());
+  Pack(DeviceId, Params, Image.data());
+
+  FILE* fd = fopen(Path, "wb");
+  if (!fd)
+     return false;
+  bool Ok = fwrite(Image.data(), 1, Image.size(), fd) == Image.size();
+  return (fclose(fd) == 0) and Ok;
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include "MLX90640_API.h"
+
+#ifdef ARDUINO
+   #include <FS.h>
+#endif
+
+/*******************************************************************************
+ * MLX90640Cache, the extracted calibration (paramsMLX90640) of one sensor in
+ * a file, so that startup can skip the 832 word EEPROM dump and
+ * MLX90640_ExtractParameters().
+ *
+ * The file is a 24 byte header and the paramsMLX90640 as in memory:
+ *   "MLXC", uint16 version, uint16 reserved, uint32 sizeof(paramsMLX90640),
+ *   uint16 device id[3] (EEPROM 0x2407..0x2409), uint16 reserved,
+ *   uint32 CRC-32 of the paramsMLX90640 bytes.
+ * It's only used if all of them match, ie. a different sensor, a firmware
+ * with another paramsMLX90640 layout or a damaged file means a cold start.
+ *
+ * On the ESP32 the file lives on any fs::FS, ie. SPIFFS (flash) or SD;
+ * on the host it's a plain file.
+ ******************************************************************************/
+class MLX90640Cache {
+private:
+#ifdef ARDUINO
+  fs::FS&     Fs;
+#endif
+  const char* Path;
+
+public:
+  static const uint16_t Version = 1;
+
+#ifdef ARDUINO
+  MLX90640Cache(fs::FS& Fs, const char* Path) : Fs(Fs), Path(Path) {}
+#else
+  explicit MLX90640Cache(const char* Path) : Path(Path) {}
+#endif
+
+  /* true, if the file holds the calibration of the sensor 'DeviceId'. */
+  bool Load(const uint16_t* DeviceId, paramsMLX90640* Params);
+  bool Save(const uint16_t* DeviceId, const paramsMLX90640* Params);
+
+  /* the three device id words, 0 on success or the I2C error. */
+  static int DeviceId(uint8_t SlaveAddr, uint16_t* DeviceId);
+
+  /* the file contents as bytes, Size() of them. */
+  static uint32_t Size(void);
+  static void Pack(const uint16_t* DeviceId, const paramsMLX90640* Params, uint8_t* Image);
+  static bool Unpack(const uint8_t* Image, uint32_t Length, const uint16_t* DeviceId,
+                     paramsMLX90640* Params);
+};
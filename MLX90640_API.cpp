@@ -17,10 +17,24 @@
 #include "MLX90640_API.h"
 
 #include <tgmath.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+// host builds (see MLX90640Bench/) have no bus timing to wait for.
+static void delayMicroseconds(unsigned int us) { (void)us; }
+#endif
 
 #include "MLX90640_I2C_Driver.h"
 
+// control register 1 of a sensor as last read or written, slaveAddr 0: unused
+typedef struct {
+    uint8_t slaveAddr;
+    uint8_t valid;
+    uint16_t controlRegister1;
+} shadowMLX90640;
+
 void ExtractVDDParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractPTATParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractGainParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
@@ -28,16 +42,59 @@ void ExtractTgcParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractResolutionParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractKsTaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractKsToParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
-void ExtractAlphaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
-void ExtractOffsetParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
-void ExtractKtaPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
-void ExtractKvPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
+void ExtractPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
+int8_t RoundScaled(int value, int shift);
 void ExtractCPParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 void ExtractCILCParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 int ExtractDeviatingPixels(uint16_t *eeData, paramsMLX90640 *mlx90640);
 int CheckAdjacentPixels(uint16_t pix1, uint16_t pix2);
+int ReadFrameData(uint8_t slaveAddr, uint16_t *frameData);
+void SetSchedulerRate(schedulerMLX90640 *scheduler, uint16_t controlRegister1);
+void SchedulerArrival(schedulerMLX90640 *scheduler, int polls,
+                      unsigned long lastPoll, unsigned long pollStart);
+void SchedulerFrame(schedulerMLX90640 *scheduler, uint16_t *frameData);
+shadowMLX90640 *FindShadow(uint8_t slaveAddr);
+int ReadControlRegister1(uint8_t slaveAddr, uint16_t *controlRegister1);
+int WriteControlRegister1(uint8_t slaveAddr, uint16_t controlRegister1);
 float GetMedian(float *values, int n);
 int IsPixelBad(uint16_t pixel, paramsMLX90640 *params);
+int IsPixelPlanned(uint16_t pixel, const correctionPlanMLX90640 *plan);
+void PlanPixel(correctionPlanMLX90640 *plan, int n);
+void SetCorrectionStep(correctionStepMLX90640 *step, uint8_t rule, int source0,
+                       int source1, int source2, int source3);
+float GetTaVdd(uint16_t *frameData, const paramsMLX90640 *params, float vdd);
+void BuildPixelTables(void);
+float FourthRootFast(float x, int iterations);
+void BuildFourthRootTable(void);
+uint32_t FourthRootFixed(uint64_t x);
+void BuildReciprocalTable(void);
+static inline int64_t DivideFixed(int64_t x, int64_t divisor);
+static inline float PixelTo(float irData, float alphaCompensated, float taTr,
+                            const float *alphaCorrR,
+                            const paramsMLX90640 *params);
+
+// pixels read in each subpage, [0: interleaved, 1: chess][subpage], in
+// ascending order, and the conversion pattern of each pixel.
+static uint16_t activePixels[2][2][384];
+static int8_t conversionPatterns[768];
+static bool pixelTablesBuilt = false;
+
+// scratch of MLX90640_ExtractParameters(): the alpha of each pixel until the
+// scale of the largest one is known. Static instead of on the caller's
+// (loop task) stack; the extraction isn't reentrant.
+static float extractionScratch[768];
+
+static toConversionMLX90640 toConversion = MLX90640_TO_EXACT;
+
+static shadowMLX90640 shadows[MLX90640_SHADOW_SENSORS];
+
+// x^(1/4) in Q20 of x = 2^j * (1 + i/64), at [j * 64 + i], see FourthRootFixed()
+static uint32_t fourthRootTable[257];
+static bool fourthRootTableBuilt = false;
+
+// 2^62 / m in the middle of each m = 2^31 * (1 + i/256), see DivideFixed()
+static uint32_t reciprocalTable[256];
+static bool reciprocalTableBuilt = false;
 
 int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData) {
     return MLX90640_I2CRead(slaveAddr, 0x2400, 832, eeData);
@@ -45,10 +102,8 @@ int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData) {
 
 int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData) {
     uint16_t dataReady = 1;
-    uint16_t controlRegister1;
     uint16_t statusRegister;
-    int error   = 1;
-    uint8_t cnt = 0;
+    int error = 1;
 
     dataReady = 0;
     while (dataReady == 0) {
@@ -60,40 +115,288 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData) {
         dataReady = statusRegister & 0x0008;
     }
 
-    while (dataReady != 0 && cnt < 5) {
+    return ReadFrameData(slaveAddr, frameData);
+}
+
+//------------------------------------------------------------------------------
+
+// if control register 1 can't be read, returns the error with the scheduler
+// unsynchronized at the power on default rate; the first frame corrects it.
+int MLX90640_InitScheduler(uint8_t slaveAddr, schedulerMLX90640 *scheduler) {
+    uint16_t controlRegister1;
+    int error;
+
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
+    if (error != 0) {
+        controlRegister1 = MLX90640_CONTROL_REGISTER1_POR;
+    }
+
+    memset(scheduler, 0, sizeof(schedulerMLX90640));
+    scheduler->slaveAddr = slaveAddr;
+    SetSchedulerRate(scheduler, controlRegister1);
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t MLX90640_SchedulerIdleTime(const schedulerMLX90640 *scheduler) {
+    int32_t idle;
+
+    if (!scheduler->synchronized) {
+        return 0;
+    }
+
+    idle = (int32_t)(scheduler->lastArrival + scheduler->period -
+                     scheduler->guard - MLX90640_I2CMicros());
+
+    return idle > 0 ? idle : 0;
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_GetFrameDataScheduled(schedulerMLX90640 *scheduler,
+                                   uint16_t *frameData) {
+    uint16_t statusRegister;
+    uint32_t idle;
+    uint32_t backoff;
+    unsigned long pollStart;
+    unsigned long lastPoll = 0;
+    int polls = 0;
+    int error;
+
+    // the time until shortly before the next subpage is the caller's ...
+    idle = MLX90640_SchedulerIdleTime(scheduler);
+    if (idle > 0) {
+        MLX90640_I2CDelay(idle);
+        scheduler->sleptMicros += idle;
+    }
+
+    // ... then poll, at growing intervals up to a quarter of the guard time
+    backoff = scheduler->guard / 8;
+    while (1) {
+        pollStart = MLX90640_I2CMicros();
+        error = MLX90640_I2CRead(scheduler->slaveAddr, 0x8000, 1, &statusRegister);
+        if (error != 0) {
+            return error;
+        }
+        polls = polls + 1;
+        scheduler->polls++;
+        if (statusRegister & 0x0008) {
+            break;
+        }
+
+        scheduler->idlePolls++;
+        scheduler->idleMicros += MLX90640_I2CMicros() - pollStart;
+        lastPoll = pollStart;
+        MLX90640_I2CDelay(backoff);
+        scheduler->sleptMicros += backoff;
+        if (backoff < scheduler->guard / 4) {
+            backoff = backoff * 2;
+        }
+    }
+
+    SchedulerArrival(scheduler, polls, lastPoll, pollStart);
+
+    error = ReadFrameData(scheduler->slaveAddr, frameData);
+    if (error < 0) {
+        return error;
+    }
+    SchedulerFrame(scheduler, frameData);
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_InitAcquisition(acquisitionMLX90640 *acquisition,
+                              uint8_t slaveAddr, schedulerMLX90640 *scheduler,
+                              uint16_t chunkWords) {
+    memset(acquisition, 0, sizeof(acquisitionMLX90640));
+    acquisition->slaveAddr = slaveAddr;
+    acquisition->scheduler = scheduler;
+    acquisition->chunk     = chunkWords > 0 ? chunkWords : 832;
+    acquisition->state     = MLX90640_ACQUISITION_IDLE;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_StartAcquisition(acquisitionMLX90640 *acquisition,
+                               uint16_t *frameData) {
+    acquisition->frameData = frameData;
+    acquisition->state     = MLX90640_ACQUISITION_WAIT;
+    acquisition->attempts  = 0;
+    acquisition->next      = 0;
+    acquisition->polls     = 0;
+    acquisition->result    = 0;
+    acquisition->notBefore = MLX90640_I2CMicros();
+    if (acquisition->scheduler != NULL) {
+        acquisition->notBefore += MLX90640_SchedulerIdleTime(acquisition->scheduler);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_PollAcquisition(acquisitionMLX90640 *acquisition) {
+    schedulerMLX90640 *scheduler = acquisition->scheduler;
+    uint8_t slaveAddr            = acquisition->slaveAddr;
+    uint16_t *frameData          = acquisition->frameData;
+    uint16_t controlRegister1;
+    unsigned long pollStart;
+    unsigned int words;
+    int error;
+
+    switch (acquisition->state) {
+    case MLX90640_ACQUISITION_WAIT:
+        if (MLX90640_AcquisitionIdleTime(acquisition) > 0) {
+            return 0;
+        }
+        pollStart = MLX90640_I2CMicros();
+        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &acquisition->statusRegister);
+        if (error != 0) {
+            break;
+        }
+        acquisition->polls = acquisition->polls + 1;
+        if (scheduler != NULL) {
+            scheduler->polls++;
+        }
+        if ((acquisition->statusRegister & 0x0008) == 0) {
+            if (scheduler != NULL) {
+                scheduler->idlePolls++;
+                scheduler->idleMicros += MLX90640_I2CMicros() - pollStart;
+                acquisition->notBefore = pollStart + scheduler->guard / 8;
+            } else {
+                acquisition->notBefore = pollStart + MLX90640_ACQUISITION_BACKOFF;
+            }
+            acquisition->lastPoll = pollStart;
+            return 0;
+        }
+        if (scheduler != NULL) {
+            SchedulerArrival(scheduler, acquisition->polls, acquisition->lastPoll,
+                             pollStart);
+        }
+        acquisition->state = MLX90640_ACQUISITION_CLEAR;
+        return 0;
+
+    case MLX90640_ACQUISITION_CLEAR:
         error = MLX90640_I2CWrite(slaveAddr, 0x8000, 0x0030);
         if (error == -1) {
-            return error;
+            break;
+        }
+        acquisition->next  = 0;
+        acquisition->state = MLX90640_ACQUISITION_READ;
+        // fall through - the write is short, the first chunk takes this step too
+
+    case MLX90640_ACQUISITION_READ:
+        words = 832 - acquisition->next;
+        if (words > acquisition->chunk) {
+            words = acquisition->chunk;
+        }
+        error = MLX90640_I2CRead(slaveAddr, 0x0400 + acquisition->next, words,
+                                 frameData + acquisition->next);
+        if (error != 0) {
+            break;
+        }
+        acquisition->next = acquisition->next + words;
+        if (acquisition->next == 832) {
+            acquisition->state = MLX90640_ACQUISITION_CHECK;
         }
+        return 0;
 
-        error = MLX90640_I2CRead(slaveAddr, 0x0400, 832, frameData);
+    case MLX90640_ACQUISITION_CHECK:
+        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &acquisition->statusRegister);
         if (error != 0) {
-            return error;
+            break;
         }
+        acquisition->attempts = acquisition->attempts + 1;
 
-        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &statusRegister);
+        // the next subpage came during the read, which takes it instead
+        if (acquisition->statusRegister & 0x0008) {
+            if (acquisition->attempts > 4) {
+                error = -8;
+                break;
+            }
+            acquisition->state = MLX90640_ACQUISITION_CLEAR;
+            return 0;
+        }
+
+        error          = ReadControlRegister1(slaveAddr, &controlRegister1);
+        frameData[832] = controlRegister1;
+        frameData[833] = acquisition->statusRegister & 0x0001;
         if (error != 0) {
-            return error;
+            break;
         }
-        dataReady = statusRegister & 0x0008;
-        cnt       = cnt + 1;
+        if (scheduler != NULL) {
+            SchedulerFrame(scheduler, frameData);
+        }
+        acquisition->result = frameData[833];
+        acquisition->state  = MLX90640_ACQUISITION_COMPLETE;
+        return 1;
+
+    case MLX90640_ACQUISITION_COMPLETE:
+        return 1;
+
+    case MLX90640_ACQUISITION_FAILED:
+        return acquisition->result;
+
+    default:
+        // not started
+        return 0;
     }
 
-    if (cnt > 4) {
-        return -8;
+    acquisition->result = error;
+    acquisition->state  = MLX90640_ACQUISITION_FAILED;
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_IsAcquisitionComplete(const acquisitionMLX90640 *acquisition) {
+    return acquisition->state == MLX90640_ACQUISITION_COMPLETE;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t MLX90640_AcquisitionIdleTime(const acquisitionMLX90640 *acquisition) {
+    int32_t idle;
+
+    if (acquisition->state != MLX90640_ACQUISITION_WAIT) {
+        return 0;
     }
 
-    error          = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
-    frameData[832] = controlRegister1;
-    frameData[833] = statusRegister & 0x0001;
+    idle = (int32_t)(acquisition->notBefore - MLX90640_I2CMicros());
 
-    if (error != 0) {
-        return error;
+    return idle > 0 ? idle : 0;
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_CompleteAcquisition(acquisitionMLX90640 *acquisition) {
+    uint32_t idle;
+    int done;
+
+    if (acquisition->state == MLX90640_ACQUISITION_IDLE) {
+        return -1;
     }
 
-    return frameData[833];
+    done = MLX90640_PollAcquisition(acquisition);
+    while (done == 0) {
+        idle = MLX90640_AcquisitionIdleTime(acquisition);
+        if (idle > 0) {
+            MLX90640_I2CDelay(idle);
+            if (acquisition->scheduler != NULL) {
+                acquisition->scheduler->sleptMicros += idle;
+            }
+        }
+        done = MLX90640_PollAcquisition(acquisition);
+    }
+
+    return acquisition->result;
 }
 
+//------------------------------------------------------------------------------
+
 int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
     int error = 0;
 
@@ -105,12 +408,10 @@ int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
     ExtractKsTaParameters(eeData, mlx90640);
     ExtractKsToParameters(eeData, mlx90640);
     ExtractCPParameters(eeData, mlx90640);
-    ExtractAlphaParameters(eeData, mlx90640);
-    ExtractOffsetParameters(eeData, mlx90640);
-    ExtractKtaPixelParameters(eeData, mlx90640);
-    ExtractKvPixelParameters(eeData, mlx90640);
+    ExtractPixelParameters(eeData, mlx90640);
     ExtractCILCParameters(eeData, mlx90640);
     error = ExtractDeviatingPixels(eeData, mlx90640);
+    BuildPixelTables();
 
     return error;
 }
@@ -124,11 +425,11 @@ int MLX90640_SetResolution(uint8_t slaveAddr, uint8_t resolution) {
 
     value = (resolution & 0x03) << 10;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
 
     if (error == 0) {
         value = (controlRegister1 & 0xF3FF) | value;
-        error = MLX90640_I2CWrite(slaveAddr, 0x800D, value);
+        error = WriteControlRegister1(slaveAddr, value);
     }
 
     return error;
@@ -141,7 +442,7 @@ int MLX90640_GetCurResolution(uint8_t slaveAddr) {
     int resolutionRAM;
     int error;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
     if (error != 0) {
         return error;
     }
@@ -159,10 +460,10 @@ int MLX90640_SetRefreshRate(uint8_t slaveAddr, uint8_t refreshRate) {
 
     value = (refreshRate & 0x07) << 7;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
     if (error == 0) {
         value = (controlRegister1 & 0xFC7F) | value;
-        error = MLX90640_I2CWrite(slaveAddr, 0x800D, value);
+        error = WriteControlRegister1(slaveAddr, value);
     }
 
     return error;
@@ -175,7 +476,7 @@ int MLX90640_GetRefreshRate(uint8_t slaveAddr) {
     int refreshRate;
     int error;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
     if (error != 0) {
         return error;
     }
@@ -191,11 +492,11 @@ int MLX90640_SetInterleavedMode(uint8_t slaveAddr) {
     int value;
     int error;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
 
     if (error == 0) {
         value = (controlRegister1 & 0xEFFF);
-        error = MLX90640_I2CWrite(slaveAddr, 0x800D, value);
+        error = WriteControlRegister1(slaveAddr, value);
     }
 
     return error;
@@ -208,11 +509,11 @@ int MLX90640_SetChessMode(uint8_t slaveAddr) {
     int value;
     int error;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
 
     if (error == 0) {
         value = (controlRegister1 | 0x1000);
-        error = MLX90640_I2CWrite(slaveAddr, 0x800D, value);
+        error = WriteControlRegister1(slaveAddr, value);
     }
 
     return error;
@@ -225,7 +526,7 @@ int MLX90640_GetCurMode(uint8_t slaveAddr) {
     int modeRAM;
     int error;
 
-    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, &controlRegister1);
+    error = ReadControlRegister1(slaveAddr, &controlRegister1);
     if (error != 0) {
         return error;
     }
@@ -236,53 +537,26 @@ int MLX90640_GetCurMode(uint8_t slaveAddr) {
 
 //------------------------------------------------------------------------------
 
-void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
-                          float emissivity, float tr, float *result) {
+void MLX90640_InvalidateShadow(uint8_t slaveAddr) {
+    shadowMLX90640 *shadow = FindShadow(slaveAddr);
+
+    if (shadow != NULL) {
+        shadow->valid = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_GetFrameContext(uint16_t *frameData, const paramsMLX90640 *params,
+                              frameContextMLX90640 *context) {
     float vdd;
     float ta;
-    float ta4;
-    float tr4;
-    float taTr;
     float gain;
     float irDataCP[2];
-    float irData;
-    float alphaCompensated;
     uint8_t mode;
-    int8_t ilPattern;
-    int8_t chessPattern;
-    int8_t pattern;
-    int8_t conversionPattern;
-    float Sx;
-    float To;
-    float alphaCorrR[4];
-    int8_t range;
-    uint16_t subPage;
-    float ktaScale;
-    float kvScale;
-    float alphaScale;
-    float kta;
-    float kv;
-
-    subPage = frameData[833];
-    vdd     = MLX90640_GetVdd(frameData, params);
-    ta      = MLX90640_GetTa(frameData, params);
 
-    ta4  = (ta + 273.15f);
-    ta4  = ta4 * ta4;
-    ta4  = ta4 * ta4;
-    tr4  = (tr + 273.15f);
-    tr4  = tr4 * tr4;
-    tr4  = tr4 * tr4;
-    taTr = tr4 - (tr4 - ta4) / emissivity;
-
-    ktaScale   = pow(2.0f, params->ktaScale);
-    kvScale    = pow(2.0f, params->kvScale);
-    alphaScale = pow(2.0f, params->alphaScale);
-
-    alphaCorrR[0] = 1.0f / (1.0f + params->ksTo[0] * 40.0f);
-    alphaCorrR[1] = 1.0f;
-    alphaCorrR[2] = (1.0f + params->ksTo[1] * params->ct[2]);
-    alphaCorrR[3] = alphaCorrR[2] * (1.0f + params->ksTo[2] * (params->ct[3] - params->ct[2]));
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta  = GetTaVdd(frameData, params, vdd);
 
     //------------------------- Gain calculation
     //-----------------------------------
@@ -293,33 +567,8 @@ void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
 
     gain = params->gainEE / gain;
 
-    //------------------------- To calculation
-    //-------------------------------------
     mode = (frameData[832] & 0x1000) >> 5;
 
- /* {
-    static float avg_CP0[16];
-    static float avg_CP1[16];
-    static int idx;
-
-    idx = (idx + 1) % 16;
-
-    avg_CP0[idx] = frameData[776];
-    avg_CP1[idx] = frameData[808];
-
-    float f;
-
-    f=0.0f;
-    for(int i=0; i<16; i++)
-       f+=avg_CP0[i];
-    irDataCP[0] = 0.0625f * f;
-
-    f=0.0f;
-    for(int i=0; i<16; i++)
-       f+=avg_CP1[i];
-    irDataCP[1] = 0.0625f * f;
-    }*/
-
     irDataCP[0] = frameData[776];
     irDataCP[1] = frameData[808];
     for (int i = 0; i < 2; i++) {
@@ -342,212 +591,714 @@ void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
                               (1.0f + params->cpKv * (vdd - 3.3f));
     }
 
-    for (int pixelNumber = 0; pixelNumber < 768; pixelNumber++) {
-        ilPattern         = pixelNumber / 32 - (pixelNumber / 64) * 2;
-        chessPattern      = ilPattern ^ (pixelNumber - (pixelNumber / 2) * 2);
-        conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 +
-                             (pixelNumber + 1) / 4 - pixelNumber / 4) *
-                            (1 - 2 * ilPattern);
+    context->subPage     = frameData[833];
+    context->mode        = mode;
+    context->vdd         = vdd;
+    context->ta          = ta;
+    context->gain        = gain;
+    context->irDataCP[0] = irDataCP[0];
+    context->irDataCP[1] = irDataCP[1];
 
-        if (mode == 0) {
-            pattern = ilPattern;
-        } else {
-            pattern = chessPattern;
-        }
+    context->alphaCorrR[0] = 1.0f / (1.0f + params->ksTo[0] * 40.0f);
+    context->alphaCorrR[1] = 1.0f;
+    context->alphaCorrR[2] = (1.0f + params->ksTo[1] * params->ct[2]);
+    context->alphaCorrR[3] =
+        context->alphaCorrR[2] *
+        (1.0f + params->ksTo[2] * (params->ct[3] - params->ct[2]));
 
-        if (pattern == frameData[833]) {
-            irData = frameData[pixelNumber];
-            if (irData > 32767) {
-                irData = irData - 65536;
-            }
-            irData = irData * gain;
+    MLX90640_SetFrameEmissivity(context, 1.0f, ta);
+}
 
-            kta    = params->kta[pixelNumber] / ktaScale;
-            kv     = params->kv[pixelNumber] / kvScale;
-            irData = irData - params->offset[pixelNumber] *
-                                  (1.0f + kta * (ta - 25.0f)) *
-                                  (1.0f + kv * (vdd - 3.3f));
+//------------------------------------------------------------------------------
 
-            if (mode != params->calibrationModeEE) {
-                irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) -
-                         params->ilChessC[1] * conversionPattern;
-            }
+void MLX90640_SetFrameEmissivity(frameContextMLX90640 *context,
+                                 float emissivity, float tr) {
+    float ta4;
+    float tr4;
 
-            irData = irData - params->tgc * irDataCP[subPage];
-            irData = irData / emissivity;
-
-            alphaCompensated =
-                SCALEALPHA * alphaScale / params->alpha[pixelNumber];
-            alphaCompensated =
-                alphaCompensated * (1.0f + params->KsTa * (ta - 25.0f));
-
-            Sx = alphaCompensated * alphaCompensated * alphaCompensated *
-                 (irData + alphaCompensated * taTr);
-            Sx = sqrt(sqrt(Sx)) * params->ksTo[1];
-
-            To = sqrt(sqrt(irData / (alphaCompensated *
-                                         (1.0f - params->ksTo[1] * 273.15f) +
-                                     Sx) +
-                           taTr)) -
-                 273.15f;
-
-            if (To < params->ct[1]) {
-                range = 0;
-            } else if (To < params->ct[2]) {
-                range = 1;
-            } else if (To < params->ct[3]) {
-                range = 2;
-            } else {
-                range = 3;
-            }
+    ta4 = (context->ta + 273.15f);
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = (tr + 273.15f);
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
 
-            To = sqrt(sqrt(irData / (alphaCompensated * alphaCorrR[range] *
-                                     (1 + params->ksTo[range] *
-                                              (To - params->ct[range]))) +
-                           taTr)) -
-                 273.15f;
+    context->emissivity = emissivity;
+    context->tr         = tr;
+    context->taTr       = tr4 - (tr4 - ta4) / emissivity;
+}
 
-            result[pixelNumber] = To;
-        }
-    }
+//------------------------------------------------------------------------------
+
+void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
+                          float emissivity, float tr, float *result) {
+    frameContextMLX90640 context;
+
+    MLX90640_GetFrameContext(frameData, params, &context);
+    MLX90640_SetFrameEmissivity(&context, emissivity, tr);
+    MLX90640_CalculateTo(frameData, params, &context, result);
 }
 
 //------------------------------------------------------------------------------
 
-void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params,
-                       float *result) {
-    float vdd;
-    float ta;
-    float gain;
-    float irDataCP[2];
+void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
+                          const frameContextMLX90640 *context, float *result) {
     float irData;
     float alphaCompensated;
-    uint8_t mode;
     int8_t ilPattern;
-    int8_t chessPattern;
-    int8_t pattern;
     int8_t conversionPattern;
-    float image;
-    uint16_t subPage;
     float ktaScale;
     float kvScale;
+    float alphaScale;
     float kta;
     float kv;
+    const uint16_t *pixels;
+    int pixelNumber;
 
-    subPage = frameData[833];
-    vdd     = MLX90640_GetVdd(frameData, params);
-    ta      = MLX90640_GetTa(frameData, params);
+    if (context->subPage > 1) {
+        return;
+    }
 
-    ktaScale = pow(2, (double)params->ktaScale);
-    kvScale  = pow(2, (double)params->kvScale);
+    ktaScale   = ldexpf(1.0f, params->ktaScale);
+    kvScale    = ldexpf(1.0f, params->kvScale);
+    alphaScale = ldexpf(1.0f, params->alphaScale);
 
-    //------------------------- Gain calculation
-    //-----------------------------------
-    gain = frameData[778];
-    if (gain > 32767) {
-        gain = gain - 65536;
+    if (!pixelTablesBuilt) {
+        BuildPixelTables();
     }
+    pixels = activePixels[context->mode == 0 ? 0 : 1][context->subPage];
 
-    gain = params->gainEE / gain;
-
-    //------------------------- Image calculation
-    //-------------------------------------
-    mode = (frameData[832] & 0x1000) >> 5;
+    for (int n = 0; n < 384; n++) {
+        pixelNumber       = pixels[n];
+        ilPattern         = (pixelNumber >> 5) & 1;
+        conversionPattern = conversionPatterns[pixelNumber];
 
-    irDataCP[0] = frameData[776];
-    irDataCP[1] = frameData[808];
-    for (int i = 0; i < 2; i++) {
-        if (irDataCP[i] > 32767) {
-            irDataCP[i] = irDataCP[i] - 65536;
+        irData = frameData[pixelNumber];
+        if (irData > 32767) {
+            irData = irData - 65536;
         }
-        irDataCP[i] = irDataCP[i] * gain;
-    }
-    irDataCP[0] = irDataCP[0] - params->cpOffset[0] *
-                                    (1.0f + params->cpKta * (ta - 25.0f)) *
-                                    (1.0f + params->cpKv * (vdd - 3.3f));
-    if (mode == params->calibrationModeEE) {
-        irDataCP[1] = irDataCP[1] - params->cpOffset[1] *
-                                        (1.0f + params->cpKta * (ta - 25.0f)) *
-                                        (1.0f + params->cpKv * (vdd - 3.3f));
-    } else {
-        irDataCP[1] =
-            irDataCP[1] - (params->cpOffset[1] + params->ilChessC[0]) *
-                              (1.0f + params->cpKta * (ta - 25.0f)) *
-                              (1.0f + params->cpKv * (vdd - 3.3f));
-    }
+        irData = irData * context->gain;
 
-    for (int pixelNumber = 0; pixelNumber < 768; pixelNumber++) {
-        ilPattern         = pixelNumber / 32 - (pixelNumber / 64) * 2;
-        chessPattern      = ilPattern ^ (pixelNumber - (pixelNumber / 2) * 2);
-        conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 +
-                             (pixelNumber + 1) / 4 - pixelNumber / 4) *
-                            (1 - 2 * ilPattern);
+        kta    = params->kta[pixelNumber] / ktaScale;
+        kv     = params->kv[pixelNumber] / kvScale;
+        irData = irData - params->offset[pixelNumber] *
+                              (1.0f + kta * (context->ta - 25.0f)) *
+                              (1.0f + kv * (context->vdd - 3.3f));
 
-        if (mode == 0) {
-            pattern = ilPattern;
-        } else {
-            pattern = chessPattern;
+        if (context->mode != params->calibrationModeEE) {
+            irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) -
+                     params->ilChessC[1] * conversionPattern;
         }
 
-        if (pattern == frameData[833]) {
-            irData = frameData[pixelNumber];
-            if (irData > 32767) {
-                irData = irData - 65536;
-            }
-            irData = irData * gain;
+        irData = irData - params->tgc * context->irDataCP[context->subPage];
+        irData = irData / context->emissivity;
 
-            kta    = params->kta[pixelNumber] / ktaScale;
-            kv     = params->kv[pixelNumber] / kvScale;
-            irData = irData - params->offset[pixelNumber] *
-                                  (1.0f + kta * (ta - 25.0f)) *
-                                  (1.0f + kv * (vdd - 3.3f));
+        alphaCompensated =
+            SCALEALPHA * alphaScale / params->alpha[pixelNumber];
+        alphaCompensated =
+            alphaCompensated * (1.0f + params->KsTa * (context->ta - 25.0f));
 
-            if (mode != params->calibrationModeEE) {
-                irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) -
-                         params->ilChessC[1] * conversionPattern;
-            }
+        result[pixelNumber] = PixelTo(irData, alphaCompensated, context->taTr,
+                                      context->alphaCorrR, params);
+    }
+}
+
+//------------------------------------------------------------------------------
 
-            irData = irData - params->tgc * irDataCP[subPage];
+void MLX90640_SetToConversion(toConversionMLX90640 mode) {
+    toConversion = mode;
+}
 
-            alphaCompensated = params->alpha[pixelNumber];
+//------------------------------------------------------------------------------
 
-            image = irData * alphaCompensated;
+// object temperature of one pixel from its compensated IR signal, in the
+// selected toConversion mode.
+static inline float PixelTo(float irData, float alphaCompensated, float taTr,
+                            const float *alphaCorrR,
+                            const paramsMLX90640 *params) {
+    float Sx;
+    float To;
+    int8_t range;
+    bool fast = toConversion == MLX90640_TO_FAST;
+
+    Sx = alphaCompensated * alphaCompensated * alphaCompensated *
+         (irData + alphaCompensated * taTr);
+    Sx = (fast ? FourthRootFast(Sx, 2) : sqrt(sqrt(Sx))) * params->ksTo[1];
+
+    To = irData / (alphaCompensated * (1.0f - params->ksTo[1] * 273.15f) + Sx) +
+         taTr;
+    To = (fast ? FourthRootFast(To, 2) : sqrt(sqrt(To))) - 273.15f;
+
+    if (To < params->ct[1]) {
+        range = 0;
+    } else if (To < params->ct[2]) {
+        range = 1;
+    } else if (To < params->ct[3]) {
+        range = 2;
+    } else {
+        range = 3;
+    }
 
-            result[pixelNumber] = image;
-        }
+    // in range 1 (alphaCorrR = 1, ct = 0) both formulas agree to first
+    // order, as Sx already approximates ksTo[1] * (To + 273.15).
+    if (toConversion == MLX90640_TO_SINGLE_PASS && range == 1 &&
+        To > params->ct[1] + MLX90640_SINGLE_PASS_MARGIN &&
+        To < params->ct[2] - MLX90640_SINGLE_PASS_MARGIN) {
+        return To;
     }
+
+    To = irData / (alphaCompensated * alphaCorrR[range] *
+                   (1 + params->ksTo[range] * (To - params->ct[range]))) +
+         taTr;
+    To = (fast ? FourthRootFast(To, 3) : sqrt(sqrt(To))) - 273.15f;
+
+    return To;
 }
 
 //------------------------------------------------------------------------------
 
-float MLX90640_GetVdd(uint16_t *frameData, const paramsMLX90640 *params) {
-    float vdd;
-    float resolutionCorrection;
+void MLX90640_PrepareParameters(const paramsMLX90640 *params,
+                                preparedMLX90640 *prepared) {
+    float ktaScale;
+    float kvScale;
+    float alphaScale;
+    int8_t ilPattern;
+    int8_t chessPattern;
 
-    int resolutionRAM;
+    ktaScale   = ldexpf(1.0f, params->ktaScale);
+    kvScale    = ldexpf(1.0f, params->kvScale);
+    alphaScale = ldexpf(1.0f, params->alphaScale);
 
-    vdd = frameData[810];
-    if (vdd > 32767) {
-        vdd = vdd - 65536;
-    }
-    resolutionRAM = (frameData[832] & 0x0C00) >> 10;
-    resolutionCorrection =
-        pow(2.0f, params->resolutionEE) / pow(2.0f, resolutionRAM);
-    vdd = (resolutionCorrection * vdd - params->vdd25) / params->kVdd + 3.3f;
+    for (int pixelNumber = 0; pixelNumber < 768; pixelNumber++) {
+        prepared->kta[pixelNumber] = params->kta[pixelNumber] / ktaScale;
+        prepared->kv[pixelNumber]  = params->kv[pixelNumber] / kvScale;
+        prepared->alpha[pixelNumber] =
+            SCALEALPHA * alphaScale / params->alpha[pixelNumber];
+        prepared->offset[pixelNumber] = params->offset[pixelNumber];
 
-    return vdd;
+        ilPattern         = pixelNumber / 32 - (pixelNumber / 64) * 2;
+        chessPattern      = ilPattern ^ (pixelNumber - (pixelNumber / 2) * 2);
+
+        prepared->pattern[pixelNumber] =
+            (ilPattern ? MLX90640_IL_PATTERN : 0) |
+            (chessPattern ? MLX90640_CHESS_PATTERN : 0);
+    }
 }
 
 //------------------------------------------------------------------------------
 
-float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params) {
+// MLX90640_CalculateTo() on the prepared planes: same arithmetic, same
+// results, but no per pixel divisions besides the emissivity and To itself.
+void MLX90640_CalculateToPrepared(uint16_t *frameData,
+                                  const paramsMLX90640 *params,
+                                  const preparedMLX90640 *prepared,
+                                  float emissivity, float tr, float *result) {
+    frameContextMLX90640 context;
+
+    MLX90640_GetFrameContext(frameData, params, &context);
+    MLX90640_SetFrameEmissivity(&context, emissivity, tr);
+    MLX90640_CalculateToPrepared(frameData, params, prepared, &context, result);
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CalculateToPrepared(uint16_t *frameData,
+                                  const paramsMLX90640 *params,
+                                  const preparedMLX90640 *prepared,
+                                  const frameContextMLX90640 *context,
+                                  float *result) {
+    float irData;
+    float alphaCompensated;
+    const uint16_t *pixels;
+    int pixelNumber;
+    uint8_t bits;
+    float gain;
+    float emissivity;
+    float dTa;
+    float dVdd;
+    float ksTa;
+    float cpCorrection;
+    float ilChessIL[2];
+    float ilChessConv[3];
+    bool ilChessCorrection;
+
+    if (context->subPage > 1) {
+        return;
+    }
+
+    // everything below, that doesn't depend on the pixel
+    gain         = context->gain;
+    emissivity   = context->emissivity;
+    dTa          = context->ta - 25.0f;
+    dVdd         = context->vdd - 3.3f;
+    ksTa         = 1.0f + params->KsTa * dTa;
+    cpCorrection = params->tgc * context->irDataCP[context->subPage];
+
+    ilChessCorrection = context->mode != params->calibrationModeEE;
+    ilChessIL[0]      = params->ilChessC[2] * -1;
+    ilChessIL[1]      = params->ilChessC[2];
+    ilChessConv[0]    = params->ilChessC[1] * -1;
+    ilChessConv[1]    = params->ilChessC[1] * 0;
+    ilChessConv[2]    = params->ilChessC[1];
+
+    if (!pixelTablesBuilt) {
+        BuildPixelTables();
+    }
+    pixels = activePixels[context->mode == 0 ? 0 : 1][context->subPage];
+
+    for (int n = 0; n < 384; n++) {
+        pixelNumber = pixels[n];
+        bits        = prepared->pattern[pixelNumber];
+
+        irData = frameData[pixelNumber];
+        if (irData > 32767) {
+            irData = irData - 65536;
+        }
+        irData = irData * gain;
+
+        irData = irData - prepared->offset[pixelNumber] *
+                              (1.0f + prepared->kta[pixelNumber] * dTa) *
+                              (1.0f + prepared->kv[pixelNumber] * dVdd);
+
+        if (ilChessCorrection) {
+            irData = irData + ilChessIL[bits & MLX90640_IL_PATTERN] -
+                     ilChessConv[1 + conversionPatterns[pixelNumber]];
+        }
+
+        irData = irData - cpCorrection;
+        irData = irData / emissivity;
+
+        alphaCompensated = prepared->alpha[pixelNumber] * ksTa;
+
+        result[pixelNumber] = PixelTo(irData, alphaCompensated, context->taTr,
+                                      context->alphaCorrR, params);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_InitCompensation(compensatedMLX90640 *compensated,
+                               float epsilonTa, float epsilonVdd) {
+    compensated->epsilonTa  = epsilonTa;
+    compensated->epsilonVdd = epsilonVdd;
+    compensated->valid      = false;
+    compensated->updates    = 0;
+    compensated->rebuilds   = 0;
+}
+
+//------------------------------------------------------------------------------
+
+// returns 1 if the planes were rebuilt for this frame, 0 if still in use.
+int MLX90640_UpdateCompensation(const preparedMLX90640 *prepared,
+                                const paramsMLX90640 *params,
+                                const frameContextMLX90640 *context,
+                                compensatedMLX90640 *compensated) {
+    float dTa;
+    float dVdd;
+    float ksTa;
+
+    compensated->updates++;
+
+    if (compensated->valid &&
+        fabs(context->ta - compensated->ta) <= compensated->epsilonTa &&
+        fabs(context->vdd - compensated->vdd) <= compensated->epsilonVdd) {
+        return 0;
+    }
+
+    dTa  = context->ta - 25.0f;
+    dVdd = context->vdd - 3.3f;
+    ksTa = 1.0f + params->KsTa * dTa;
+
+    for (int pixelNumber = 0; pixelNumber < 768; pixelNumber++) {
+        compensated->offset[pixelNumber] =
+            prepared->offset[pixelNumber] *
+            (1.0f + prepared->kta[pixelNumber] * dTa) *
+            (1.0f + prepared->kv[pixelNumber] * dVdd);
+        compensated->alpha[pixelNumber] = prepared->alpha[pixelNumber] * ksTa;
+    }
+
+    compensated->ta    = context->ta;
+    compensated->vdd   = context->vdd;
+    compensated->valid = true;
+    compensated->rebuilds++;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+// MLX90640_CalculateToPrepared() with the Ta/Vdd compensation taken from the
+// cached planes, updated first if needed. With both epsilons 0 the results
+// are identical to MLX90640_CalculateToPrepared().
+void MLX90640_CalculateToCompensated(uint16_t *frameData,
+                                     const paramsMLX90640 *params,
+                                     const preparedMLX90640 *prepared,
+                                     compensatedMLX90640 *compensated,
+                                     const frameContextMLX90640 *context,
+                                     float *result) {
+    float irData;
+    const uint16_t *pixels;
+    int pixelNumber;
+    float gain;
+    float emissivity;
+    float cpCorrection;
+    float ilChessIL[2];
+    float ilChessConv[3];
+    bool ilChessCorrection;
+
+    if (context->subPage > 1) {
+        return;
+    }
+
+    MLX90640_UpdateCompensation(prepared, params, context, compensated);
+
+    gain         = context->gain;
+    emissivity   = context->emissivity;
+    cpCorrection = params->tgc * context->irDataCP[context->subPage];
+
+    ilChessCorrection = context->mode != params->calibrationModeEE;
+    ilChessIL[0]      = params->ilChessC[2] * -1;
+    ilChessIL[1]      = params->ilChessC[2];
+    ilChessConv[0]    = params->ilChessC[1] * -1;
+    ilChessConv[1]    = params->ilChessC[1] * 0;
+    ilChessConv[2]    = params->ilChessC[1];
+
+    if (!pixelTablesBuilt) {
+        BuildPixelTables();
+    }
+    pixels = activePixels[context->mode == 0 ? 0 : 1][context->subPage];
+
+    for (int n = 0; n < 384; n++) {
+        pixelNumber = pixels[n];
+
+        irData = frameData[pixelNumber];
+        if (irData > 32767) {
+            irData = irData - 65536;
+        }
+        irData = irData * gain - compensated->offset[pixelNumber];
+
+        if (ilChessCorrection) {
+            irData = irData +
+                     ilChessIL[prepared->pattern[pixelNumber] & MLX90640_IL_PATTERN] -
+                     ilChessConv[1 + conversionPatterns[pixelNumber]];
+        }
+
+        irData = irData - cpCorrection;
+        irData = irData / emissivity;
+
+        result[pixelNumber] =
+            PixelTo(irData, compensated->alpha[pixelNumber], context->taTr,
+                    context->alphaCorrR, params);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_InitFixed(fixedMLX90640 *fixed, float epsilonTa, float epsilonVdd) {
+    fixed->epsilonTa  = epsilonTa;
+    fixed->epsilonVdd = epsilonVdd;
+    fixed->valid      = false;
+    fixed->updates    = 0;
+    fixed->rebuilds   = 0;
+}
+
+//------------------------------------------------------------------------------
+
+// MLX90640_UpdateCompensation() in integers, straight from the EEPROM values:
+//   offset      = offset * (1 + kta / 2^ktaScale * dTa) * (1 + kv / 2^kvScale * dVdd)
+//   sensitivity = alpha * 10^6 / 2^alphaScale / (1 + KsTa * dTa)
+// Only dTa, dVdd and the KsTa factor are converted from float, once per
+// rebuild, the planes themselves take no float and no division.
+// returns 1 if the planes were rebuilt for this frame, 0 if still in use.
+int MLX90640_UpdateFixed(const paramsMLX90640 *params,
+                         const frameContextMLX90640 *context,
+                         fixedMLX90640 *fixed) {
+    int32_t dTa;              // Q20 degC
+    int32_t dVdd;             // Q20 V
+    int32_t ksTa;             // Q20
+    uint64_t scale;           // Q16 sensitivity per alpha count
+    int64_t kta;              // Q20
+    int64_t kv;               // Q20
+    uint64_t sensitivity;
+
+    fixed->updates++;
+
+    if (fixed->valid &&
+        fabsf(context->ta - fixed->ta) <= fixed->epsilonTa &&
+        fabsf(context->vdd - fixed->vdd) <= fixed->epsilonVdd) {
+        return 0;
+    }
+
+    dTa  = lrintf((context->ta - 25.0f) * 1048576.0f);
+    dVdd = lrintf((context->vdd - 3.3f) * 1048576.0f);
+    ksTa = lrintf((1.0f + params->KsTa * (context->ta - 25.0f)) * 1048576.0f);
+    if (ksTa < 1) {
+        ksTa = 1;
+    }
+
+    // 10^6 * 2^(36 - alphaScale) / ksTa
+    if (params->alphaScale <= 36) {
+        scale = (1000000ULL << (36 - params->alphaScale)) / ksTa;
+    } else {
+        scale = (1000000ULL >> (params->alphaScale - 36)) / ksTa;
+    }
+
+    for (int i = 0; i < 768; i++) {
+        kta = (1 << 20) + (((int64_t)params->kta[i] * dTa) >> params->ktaScale);
+        kv  = (1 << 20) + (((int64_t)params->kv[i] * dVdd) >> params->kvScale);
+
+        // Q0 * Q20 * Q20 to Q14
+        fixed->offset[i] =
+            (((int64_t)params->offset[i] * kta >> 10) * kv + (1 << 15)) >> 16;
+
+        sensitivity = (params->alpha[i] * scale + (1 << 15)) >> 16;
+        fixed->sensitivity[i] =
+            sensitivity > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)sensitivity;
+    }
+
+    fixed->ta    = context->ta;
+    fixed->vdd   = context->vdd;
+    fixed->valid = true;
+    fixed->rebuilds++;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+// MLX90640_CalculateToCompensated() in integers, To in 0.01 degC.
+//
+// With alpha^3 * (irData + alpha * taTr) = alpha^4 * (irData / alpha + taTr),
+// all three roots are taken from t4 = irData / alpha in K^4:
+//   T0  = (t4 + taTr)^(1/4)                                   [K]
+//   To1 = (t4 / (1 + ksTo[1] * (T0 - 273.15)) + taTr)^(1/4)
+//   To  = (t4 / (alphaCorrR[r] * (1 + ksTo[r] * (To1 - ct[r]))) + taTr)^(1/4)
+// The per frame constants are converted from the context once, the per pixel
+// chain uses only int32/int64 multiplications, shifts and the fourth root and
+// reciprocal tables.
+void MLX90640_CalculateToFixed(uint16_t *frameData,
+                                const paramsMLX90640 *params,
+                                const preparedMLX90640 *prepared,
+                                fixedMLX90640 *fixed,
+                                const frameContextMLX90640 *context,
+                                int16_t *result) {
+    const uint16_t *pixels;
+    int pixelNumber;
+    int32_t gain;             // Q14
+    int32_t cpCorrection;     // Q14
+    int32_t ilChessIL[2];     // Q14
+    int32_t ilChessConv[3];   // Q14
+    bool ilChessCorrection;
+    int32_t emissivity;       // 1 / emissivity, Q16
+    int64_t taTr;             // K^4
+    int32_t ksTo[4];          // Q30
+    int32_t ct[4];            // Q8 degC
+    int32_t alphaCorrR[4];    // Q24
+    int32_t irData;           // Q14
+    int64_t t4;
+    int64_t t4c;
+    int64_t correction;       // Q24
+    int32_t T0;               // Q8 K
+    int32_t To;               // Q8 degC
+    int8_t range;
+
+    if (context->subPage > 1) {
+        return;
+    }
+
+    MLX90640_UpdateFixed(params, context, fixed);
+
+    gain         = lrintf(context->gain * 16384.0f);
+    cpCorrection = lrintf(params->tgc * context->irDataCP[context->subPage] * 16384.0f);
+    emissivity   = lrintf(65536.0f / context->emissivity);
+    taTr         = llrintf(context->taTr);
+
+    ilChessCorrection = context->mode != params->calibrationModeEE;
+    ilChessIL[0]      = lrintf(params->ilChessC[2] * -16384.0f);
+    ilChessIL[1]      = lrintf(params->ilChessC[2] * 16384.0f);
+    ilChessConv[0]    = lrintf(params->ilChessC[1] * -16384.0f);
+    ilChessConv[1]    = 0;
+    ilChessConv[2]    = lrintf(params->ilChessC[1] * 16384.0f);
+
+    for (int i = 0; i < 4; i++) {
+        ksTo[i]       = lrintf(params->ksTo[i] * 1073741824.0f);
+        ct[i]         = params->ct[i] * 256;
+        alphaCorrR[i] = lrintf(context->alphaCorrR[i] * 16777216.0f);
+    }
+
+    if (!pixelTablesBuilt) {
+        BuildPixelTables();
+    }
+    if (!fourthRootTableBuilt) {
+        BuildFourthRootTable();
+    }
+    if (!reciprocalTableBuilt) {
+        BuildReciprocalTable();
+    }
+    pixels = activePixels[context->mode == 0 ? 0 : 1][context->subPage];
+
+    for (int n = 0; n < 384; n++) {
+        pixelNumber = pixels[n];
+
+        irData = (int16_t)frameData[pixelNumber] * gain - fixed->offset[pixelNumber];
+
+        if (ilChessCorrection) {
+            irData = irData +
+                     ilChessIL[prepared->pattern[pixelNumber] & MLX90640_IL_PATTERN] -
+                     ilChessConv[1 + conversionPatterns[pixelNumber]];
+        }
+
+        irData = irData - cpCorrection;
+
+        // irData / emissivity / alpha, K^4, limited to about 720K
+        t4 = ((int64_t)irData * emissivity) / 65536;
+        t4 = (t4 * fixed->sensitivity[pixelNumber]) / 16384;
+        if (t4 > 0x4000000000LL) {
+            t4 = 0x4000000000LL;
+        } else if (t4 < -0x4000000000LL) {
+            t4 = -0x4000000000LL;
+        }
+
+        t4c = t4 + taTr;
+        T0  = FourthRootFixed(t4c > 0 ? t4c : 0);
+
+        correction = (1 << 24) +
+                     (((int64_t)ksTo[1] * (T0 - 69926)) >> 14);  // 273.15 Q8
+        t4c = DivideFixed(t4, correction) + taTr;
+        To  = FourthRootFixed(t4c > 0 ? t4c : 0) - 69926;
+
+        if (To < ct[1]) {
+            range = 0;
+        } else if (To < ct[2]) {
+            range = 1;
+        } else if (To < ct[3]) {
+            range = 2;
+        } else {
+            range = 3;
+        }
+
+        correction = (1 << 24) + (((int64_t)ksTo[range] * (To - ct[range])) >> 14);
+        correction = (correction * alphaCorrR[range]) >> 24;
+        t4c = DivideFixed(t4, correction) + taTr;
+        To  = FourthRootFixed(t4c > 0 ? t4c : 0) - 69926;
+
+        // Q8 degC to 0.01 degC
+        To = (To * 100 + (To < 0 ? -128 : 128)) / 256;
+        if (To > 32767) {
+            To = 32767;
+        } else if (To < -32768) {
+            To = -32768;
+        }
+        result[pixelNumber] = To;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params,
+                       float *result) {
+    frameContextMLX90640 context;
+
+    MLX90640_GetFrameContext(frameData, params, &context);
+    MLX90640_GetImage(frameData, params, &context, result);
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params,
+                       const frameContextMLX90640 *context, float *result) {
+    float irData;
+    float alphaCompensated;
+    int8_t ilPattern;
+    int8_t conversionPattern;
+    float image;
+    float ktaScale;
+    float kvScale;
+    float kta;
+    float kv;
+    const uint16_t *pixels;
+    int pixelNumber;
+
+    if (context->subPage > 1) {
+        return;
+    }
+
+    ktaScale = ldexpf(1.0f, params->ktaScale);
+    kvScale  = ldexpf(1.0f, params->kvScale);
+
+    if (!pixelTablesBuilt) {
+        BuildPixelTables();
+    }
+    pixels = activePixels[context->mode == 0 ? 0 : 1][context->subPage];
+
+    for (int n = 0; n < 384; n++) {
+        pixelNumber       = pixels[n];
+        ilPattern         = (pixelNumber >> 5) & 1;
+        conversionPattern = conversionPatterns[pixelNumber];
+
+        irData = frameData[pixelNumber];
+        if (irData > 32767) {
+            irData = irData - 65536;
+        }
+        irData = irData * context->gain;
+
+        kta    = params->kta[pixelNumber] / ktaScale;
+        kv     = params->kv[pixelNumber] / kvScale;
+        irData = irData - params->offset[pixelNumber] *
+                              (1.0f + kta * (context->ta - 25.0f)) *
+                              (1.0f + kv * (context->vdd - 3.3f));
+
+        if (context->mode != params->calibrationModeEE) {
+            irData = irData + params->ilChessC[2] * (2 * ilPattern - 1) -
+                     params->ilChessC[1] * conversionPattern;
+        }
+
+        irData = irData - params->tgc * context->irDataCP[context->subPage];
+
+        alphaCompensated = params->alpha[pixelNumber];
+
+        image = irData * alphaCompensated;
+
+        result[pixelNumber] = image;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+float MLX90640_GetVdd(uint16_t *frameData, const paramsMLX90640 *params) {
+    float vdd;
+    float resolutionCorrection;
+
+    int resolutionRAM;
+
+    vdd = frameData[810];
+    if (vdd > 32767) {
+        vdd = vdd - 65536;
+    }
+    resolutionRAM = (frameData[832] & 0x0C00) >> 10;
+    resolutionCorrection = ldexpf(1.0f, params->resolutionEE - resolutionRAM);
+    vdd = (resolutionCorrection * vdd - params->vdd25) / params->kVdd + 3.3f;
+
+    return vdd;
+}
+
+//------------------------------------------------------------------------------
+
+float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params) {
+    return GetTaVdd(frameData, params, MLX90640_GetVdd(frameData, params));
+}
+
+//------------------------------------------------------------------------------
+
+float MLX90640_GetTa(const frameContextMLX90640 *context) {
+    return context->ta;
+}
+
+//------------------------------------------------------------------------------
+
+float GetTaVdd(uint16_t *frameData, const paramsMLX90640 *params, float vdd) {
     float ptat;
     float ptatArt;
-    float vdd;
     float ta;
 
-    vdd = MLX90640_GetVdd(frameData, params);
-
     ptat = frameData[800];
     if (ptat > 32767) {
         ptat = ptat - 65536;
@@ -558,7 +1309,7 @@ float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params) {
         ptatArt = ptatArt - 65536;
     }
     ptatArt =
-        (ptat / (ptat * params->alphaPTAT + ptatArt)) * pow(2, (double)18);
+        (ptat / (ptat * params->alphaPTAT + ptatArt)) * 262144.0f;
 
     ta = (ptatArt / (1.0f + params->KvPTAT * (vdd - 3.3f)) - params->vPTAT25);
     ta = ta / params->KtPTAT + 25.0f;
@@ -647,6 +1398,111 @@ void MLX90640_BadPixelsCorrection(uint16_t *pixels, float *to, int mode,
 
 //------------------------------------------------------------------------------
 
+void MLX90640_BadPixelsCorrection(uint16_t *pixels, float *to,
+                                  const frameContextMLX90640 *context,
+                                  paramsMLX90640 *params) {
+    MLX90640_BadPixelsCorrection(pixels, to, context->mode == 0 ? 0 : 1, params);
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_BuildCorrectionPlan(const paramsMLX90640 *params,
+                                 const uint16_t *userPixels, int userCount,
+                                 correctionPlanMLX90640 *plan) {
+    uint16_t pixel;
+    int error = 0;
+
+    // broken, outlier and user pixels, in this order and each once; the
+    // 0xFFFF of unused EEPROM entries are skipped.
+    plan->count = 0;
+    for (int i = 0; i < 10 + userCount; i++) {
+        if (i < 5) {
+            pixel = params->brokenPixels[i];
+        } else if (i < 10) {
+            pixel = params->outlierPixels[i - 5];
+        } else {
+            pixel = userPixels[i - 10];
+        }
+
+        if (pixel >= 768 || IsPixelPlanned(pixel, plan)) {
+            continue;
+        }
+        if (plan->count == MLX90640_PLAN_PIXELS) {
+            error = -1;
+            break;
+        }
+        plan->step[0][plan->count].pixel = pixel;
+        plan->count                      = plan->count + 1;
+    }
+
+    for (int i = 0; i < plan->count; i++) {
+        PlanPixel(plan, i);
+    }
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_ApplyCorrectionPlan(const correctionPlanMLX90640 *plan,
+                                  float *to, int mode) {
+    const correctionStepMLX90640 *step;
+    float source[4];
+    float low[2];
+    float high[2];
+    float step0;
+    float step1;
+
+    step = plan->step[mode == 1 ? 1 : 0];
+    for (int i = 0; i < plan->count; i++, step++) {
+        for (int j = 0; j < 4; j++) {
+            source[j] = to[step->source[j]];
+        }
+
+        switch (step->rule) {
+        case MLX90640_CORRECT_COPY:
+            to[step->pixel] = source[0];
+            break;
+
+        case MLX90640_CORRECT_MEAN:
+            to[step->pixel] = (source[0] + source[1]) * 0.5f;
+            break;
+
+        case MLX90640_CORRECT_MEDIAN:
+            // the middle two of four are the larger of the pair minima and
+            // the smaller of the pair maxima.
+            low[0]  = source[1] < source[0] ? source[1] : source[0];
+            high[0] = source[1] < source[0] ? source[0] : source[1];
+            low[1]  = source[3] < source[2] ? source[3] : source[2];
+            high[1] = source[3] < source[2] ? source[2] : source[3];
+            to[step->pixel] = ((low[0] < low[1] ? low[1] : low[0]) +
+                               (high[1] < high[0] ? high[1] : high[0])) *
+                              0.5f;
+            break;
+
+        default:
+            step0 = source[0] - source[1];
+            step1 = source[2] - source[3];
+            if (fabs(step0) > fabs(step1)) {
+                to[step->pixel] = source[2] + step1;
+            } else {
+                to[step->pixel] = source[0] + step0;
+            }
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_ApplyCorrectionPlan(const correctionPlanMLX90640 *plan,
+                                  float *to,
+                                  const frameContextMLX90640 *context) {
+    MLX90640_ApplyCorrectionPlan(plan, to, context->mode == 0 ? 0 : 1);
+}
+
+//------------------------------------------------------------------------------
+
 void ExtractVDDParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
     int16_t kVdd;
     int16_t vdd25;
@@ -687,7 +1543,7 @@ void ExtractPTATParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
 
     vPTAT25 = eeData[49];
 
-    alphaPTAT = (eeData[16] & 0xF000) / pow(2.0f, 14) + 8.0f;
+    alphaPTAT = ldexpf(eeData[16] & 0xF000, -14) + 8.0f;
 
     mlx90640->KvPTAT    = KvPTAT;
     mlx90640->KtPTAT    = KtPTAT;
@@ -780,17 +1636,37 @@ void ExtractKsToParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
 
 //------------------------------------------------------------------------------
 
-void ExtractAlphaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
-    int accRow[24];
-    int accColumn[32];
-    int p = 0;
+void ExtractPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
+    int8_t accRow[24];
+    int8_t accColumn[32];
+    int8_t occRow[24];
+    int8_t occColumn[32];
+    int8_t KtaRC[4];
+    int8_t KvT[4];
+    int8_t kv[4];
     int alphaRef;
+    int16_t offsetRef;
     uint8_t alphaScale;
     uint8_t accRowScale;
     uint8_t accColumnScale;
     uint8_t accRemScale;
-    float alphaTemp[768];
+    uint8_t occRowScale;
+    uint8_t occColumnScale;
+    uint8_t occRemScale;
+    uint8_t ktaScale1;
+    uint8_t ktaScale2;
+    uint8_t kvScale1;
+    uint8_t ktaScale;
+    uint8_t kvScale;
+    uint8_t split;
+    uint16_t pixelWord;
+    int16_t offset;
+    int value;
+    int ktaMax;
+    int kvMax;
+    float alphaCP;
     float temp;
+    int p;
 
     accRemScale    = eeData[32] & 0x000F;
     accColumnScale = (eeData[32] & 0x00F0) >> 4;
@@ -798,57 +1674,103 @@ void ExtractAlphaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
     alphaScale     = ((eeData[32] & 0xF000) >> 12) + 30;
     alphaRef       = eeData[33];
 
-    for (int i = 0; i < 6; i++) {
-        p             = i * 4;
-        accRow[p + 0] = (eeData[34 + i] & 0x000F);
-        accRow[p + 1] = (eeData[34 + i] & 0x00F0) >> 4;
-        accRow[p + 2] = (eeData[34 + i] & 0x0F00) >> 8;
-        accRow[p + 3] = (eeData[34 + i] & 0xF000) >> 12;
-    }
+    occRemScale    = (eeData[16] & 0x000F);
+    occColumnScale = (eeData[16] & 0x00F0) >> 4;
+    occRowScale    = (eeData[16] & 0x0F00) >> 8;
+    offsetRef      = eeData[17];
 
+    // rows and columns are 4 bit signed nibbles, 4 per word.
     for (int i = 0; i < 24; i++) {
+        accRow[i] = (eeData[34 + i / 4] >> (4 * (i % 4))) & 0x000F;
+        occRow[i] = (eeData[18 + i / 4] >> (4 * (i % 4))) & 0x000F;
         if (accRow[i] > 7) {
             accRow[i] = accRow[i] - 16;
         }
+        if (occRow[i] > 7) {
+            occRow[i] = occRow[i] - 16;
+        }
     }
 
-    for (int i = 0; i < 8; i++) {
-        p                = i * 4;
-        accColumn[p + 0] = (eeData[40 + i] & 0x000F);
-        accColumn[p + 1] = (eeData[40 + i] & 0x00F0) >> 4;
-        accColumn[p + 2] = (eeData[40 + i] & 0x0F00) >> 8;
-        accColumn[p + 3] = (eeData[40 + i] & 0xF000) >> 12;
+    for (int j = 0; j < 32; j++) {
+        accColumn[j] = (eeData[40 + j / 4] >> (4 * (j % 4))) & 0x000F;
+        occColumn[j] = (eeData[24 + j / 4] >> (4 * (j % 4))) & 0x000F;
+        if (accColumn[j] > 7) {
+            accColumn[j] = accColumn[j] - 16;
+        }
+        if (occColumn[j] > 7) {
+            occColumn[j] = occColumn[j] - 16;
+        }
     }
 
-    for (int i = 0; i < 32; i++) {
-        if (accColumn[i] > 7) {
-            accColumn[i] = accColumn[i] - 16;
+    // [split]: row odd/even * 2 + column odd/even.
+    KtaRC[0] = (int8_t)((eeData[54] & 0xFF00) >> 8);
+    KtaRC[1] = (int8_t)((eeData[55] & 0xFF00) >> 8);
+    KtaRC[2] = (int8_t)(eeData[54] & 0x00FF);
+    KtaRC[3] = (int8_t)(eeData[55] & 0x00FF);
+    ktaScale1 = ((eeData[56] & 0x00F0) >> 4) + 8;
+    ktaScale2 = (eeData[56] & 0x000F);
+
+    KvT[0] = (eeData[52] & 0xF000) >> 12;
+    KvT[1] = (eeData[52] & 0x00F0) >> 4;
+    KvT[2] = (eeData[52] & 0x0F00) >> 8;
+    KvT[3] = (eeData[52] & 0x000F);
+    kvMax  = 0;
+    for (int i = 0; i < 4; i++) {
+        if (KvT[i] > 7) {
+            KvT[i] = KvT[i] - 16;
+        }
+        if (abs(KvT[i]) > kvMax) {
+            kvMax = abs(KvT[i]);
         }
     }
+    kvScale1 = (eeData[56] & 0x0F00) >> 8;
 
+    alphaCP = mlx90640->tgc * (mlx90640->cpAlpha[0] + mlx90640->cpAlpha[1]) / 2;
+
+    // the single pass over the pixel words: offset is final, alpha waits
+    // in the scratch for the scale of the largest one, kta for its largest
+    // magnitude. All sums are integers as in the calibration; alpha's
+    // are exact in float, so it's the same value the float routines had.
+    ktaMax = 0;
     for (int i = 0; i < 24; i++) {
         for (int j = 0; j < 32; j++) {
-            p            = 32 * i + j;
-            alphaTemp[p] = (eeData[64 + p] & 0x03F0) >> 4;
-            if (alphaTemp[p] > 31) {
-                alphaTemp[p] = alphaTemp[p] - 64;
+            p         = 32 * i + j;
+            split     = 2 * (i % 2) + j % 2;
+            pixelWord = eeData[64 + p];
+
+            offset = (pixelWord & 0xFC00) >> 10;
+            if (offset > 31) {
+                offset = offset - 64;
+            }
+            offset              = offset * (1 << occRemScale);
+            mlx90640->offset[p] = offsetRef + (occRow[i] << occRowScale) +
+                                  (occColumn[j] << occColumnScale) + offset;
+
+            value = (pixelWord & 0x03F0) >> 4;
+            if (value > 31) {
+                value = value - 64;
+            }
+            value = alphaRef + (accRow[i] << accRowScale) +
+                    (accColumn[j] << accColumnScale) +
+                    value * (1 << accRemScale);
+            extractionScratch[p] =
+                SCALEALPHA / (ldexpf((float)value, -alphaScale) - alphaCP);
+
+            value = (pixelWord & 0x000E) >> 1;
+            if (value > 3) {
+                value = value - 8;
+            }
+            value = KtaRC[split] + value * (1 << ktaScale2);
+            if (abs(value) > ktaMax) {
+                ktaMax = abs(value);
             }
-            alphaTemp[p] = alphaTemp[p] * (1 << accRemScale);
-            alphaTemp[p] = (alphaRef + (accRow[i] << accRowScale) +
-                            (accColumn[j] << accColumnScale) + alphaTemp[p]);
-            alphaTemp[p] = alphaTemp[p] / pow(2.0f, alphaScale);
-            alphaTemp[p] = alphaTemp[p] -
-                           mlx90640->tgc *
-                               (mlx90640->cpAlpha[0] + mlx90640->cpAlpha[1]) /
-                               2;
-            alphaTemp[p] = SCALEALPHA / alphaTemp[p];
         }
     }
 
-    temp = alphaTemp[0];
+    temp = extractionScratch[0];
     for (int i = 1; i < 768; i++) {
-        if (alphaTemp[i] > temp) {
-            temp = alphaTemp[i];
+        if (extractionScratch[i] > temp) {
+            temp = extractionScratch[i];
         }
     }
 
@@ -858,231 +1780,58 @@ void ExtractAlphaParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
         alphaScale = alphaScale + 1;
     }
 
-    for (int i = 0; i < 768; i++) {
-        temp               = alphaTemp[i] * pow(2.0f, alphaScale);
-        mlx90640->alpha[i] = (temp + 0.5f);
-    }
-
-    mlx90640->alphaScale = alphaScale;
-}
-
-//------------------------------------------------------------------------------
-
-void ExtractOffsetParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
-    int occRow[24];
-    int occColumn[32];
-    int p = 0;
-    int16_t offsetRef;
-    uint8_t occRowScale;
-    uint8_t occColumnScale;
-    uint8_t occRemScale;
-
-    occRemScale    = (eeData[16] & 0x000F);
-    occColumnScale = (eeData[16] & 0x00F0) >> 4;
-    occRowScale    = (eeData[16] & 0x0F00) >> 8;
-    offsetRef      = eeData[17];
-    if (offsetRef > 32767) {
-        offsetRef = offsetRef - 65536;
-    }
-
-    for (int i = 0; i < 6; i++) {
-        p             = i * 4;
-        occRow[p + 0] = (eeData[18 + i] & 0x000F);
-        occRow[p + 1] = (eeData[18 + i] & 0x00F0) >> 4;
-        occRow[p + 2] = (eeData[18 + i] & 0x0F00) >> 8;
-        occRow[p + 3] = (eeData[18 + i] & 0xF000) >> 12;
-    }
-
-    for (int i = 0; i < 24; i++) {
-        if (occRow[i] > 7) {
-            occRow[i] = occRow[i] - 16;
-        }
+    // kta and kv are scaled up until the largest magnitude is >= 64.
+    ktaScale = 0;
+    while (ktaMax != 0 && ((int64_t)ktaMax << ktaScale) < (64LL << ktaScale1)) {
+        ktaScale = ktaScale + 1;
     }
 
-    for (int i = 0; i < 8; i++) {
-        p                = i * 4;
-        occColumn[p + 0] = (eeData[24 + i] & 0x000F);
-        occColumn[p + 1] = (eeData[24 + i] & 0x00F0) >> 4;
-        occColumn[p + 2] = (eeData[24 + i] & 0x0F00) >> 8;
-        occColumn[p + 3] = (eeData[24 + i] & 0xF000) >> 12;
+    kvScale = 0;
+    while (kvMax != 0 && ((int64_t)kvMax << kvScale) < (64LL << kvScale1)) {
+        kvScale = kvScale + 1;
     }
 
-    for (int i = 0; i < 32; i++) {
-        if (occColumn[i] > 7) {
-            occColumn[i] = occColumn[i] - 16;
-        }
+    for (int i = 0; i < 4; i++) {
+        kv[i] = RoundScaled(KvT[i], kvScale - kvScale1);
     }
 
     for (int i = 0; i < 24; i++) {
         for (int j = 0; j < 32; j++) {
-            p                   = 32 * i + j;
-            mlx90640->offset[p] = (eeData[64 + p] & 0xFC00) >> 10;
-            if (mlx90640->offset[p] > 31) {
-                mlx90640->offset[p] = mlx90640->offset[p] - 64;
-            }
-            mlx90640->offset[p] = mlx90640->offset[p] * (1 << occRemScale);
-            mlx90640->offset[p] =
-                (offsetRef + (occRow[i] << occRowScale) +
-                 (occColumn[j] << occColumnScale) + mlx90640->offset[p]);
-        }
-    }
-}
-
-//------------------------------------------------------------------------------
-
-void ExtractKtaPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
-    int p = 0;
-    int8_t KtaRC[4];
-    int8_t KtaRoCo;
-    int8_t KtaRoCe;
-    int8_t KtaReCo;
-    int8_t KtaReCe;
-    uint8_t ktaScale1;
-    uint8_t ktaScale2;
-    uint8_t split;
-    float ktaTemp[768];
-    float temp;
-
-    KtaRoCo = (eeData[54] & 0xFF00) >> 8;
-    if (KtaRoCo > 127) {
-        KtaRoCo = KtaRoCo - 256;
-    }
-    KtaRC[0] = KtaRoCo;
-
-    KtaReCo = (eeData[54] & 0x00FF);
-    if (KtaReCo > 127) {
-        KtaReCo = KtaReCo - 256;
-    }
-    KtaRC[2] = KtaReCo;
+            p     = 32 * i + j;
+            split = 2 * (i % 2) + j % 2;
 
-    KtaRoCe = (eeData[55] & 0xFF00) >> 8;
-    if (KtaRoCe > 127) {
-        KtaRoCe = KtaRoCe - 256;
-    }
-    KtaRC[1] = KtaRoCe;
+            temp               = ldexpf(extractionScratch[p], alphaScale);
+            mlx90640->alpha[p] = (temp + 0.5f);
 
-    KtaReCe = (eeData[55] & 0x00FF);
-    if (KtaReCe > 127) {
-        KtaReCe = KtaReCe - 256;
-    }
-    KtaRC[3] = KtaReCe;
-
-    ktaScale1 = ((eeData[56] & 0x00F0) >> 4) + 8;
-    ktaScale2 = (eeData[56] & 0x000F);
-
-    for (int i = 0; i < 24; i++) {
-        for (int j = 0; j < 32; j++) {
-            p          = 32 * i + j;
-            split      = 2 * (p / 32 - (p / 64) * 2) + p % 2;
-            ktaTemp[p] = (eeData[64 + p] & 0x000E) >> 1;
-            if (ktaTemp[p] > 3) {
-                ktaTemp[p] = ktaTemp[p] - 8;
+            value = (eeData[64 + p] & 0x000E) >> 1;
+            if (value > 3) {
+                value = value - 8;
             }
-            ktaTemp[p] = ktaTemp[p] * (1 << ktaScale2);
-            ktaTemp[p] = KtaRC[split] + ktaTemp[p];
-            ktaTemp[p] = ktaTemp[p] / pow(2, (double)ktaScale1);
-            // ktaTemp[p] = ktaTemp[p] * mlx90640->offset[p];
-        }
-    }
-
-    temp = fabs(ktaTemp[0]);
-    for (int i = 1; i < 768; i++) {
-        if (fabs(ktaTemp[i]) > temp) {
-            temp = fabs(ktaTemp[i]);
+            value            = KtaRC[split] + value * (1 << ktaScale2);
+            mlx90640->kta[p] = RoundScaled(value, ktaScale - ktaScale1);
+            mlx90640->kv[p]  = kv[split];
         }
     }
 
-    ktaScale1 = 0;
-    while (temp < 64) {
-        temp      = temp * 2;
-        ktaScale1 = ktaScale1 + 1;
-    }
-
-    for (int i = 0; i < 768; i++) {
-        temp = ktaTemp[i] * pow(2, (double)ktaScale1);
-        if (temp < 0) {
-            mlx90640->kta[i] = (temp - 0.5);
-        } else {
-            mlx90640->kta[i] = (temp + 0.5);
-        }
-    }
-
-    mlx90640->ktaScale = ktaScale1;
+    mlx90640->alphaScale = alphaScale;
+    mlx90640->ktaScale   = ktaScale;
+    mlx90640->kvScale    = kvScale;
 }
 
 //------------------------------------------------------------------------------
 
-void ExtractKvPixelParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
-    int p = 0;
-    int8_t KvT[4];
-    int8_t KvRoCo;
-    int8_t KvRoCe;
-    int8_t KvReCo;
-    int8_t KvReCe;
-    uint8_t kvScale;
-    uint8_t split;
-    float kvTemp[768];
-    float temp;
-
-    KvRoCo = (eeData[52] & 0xF000) >> 12;
-    if (KvRoCo > 7) {
-        KvRoCo = KvRoCo - 16;
-    }
-    KvT[0] = KvRoCo;
-
-    KvReCo = (eeData[52] & 0x0F00) >> 8;
-    if (KvReCo > 7) {
-        KvReCo = KvReCo - 16;
-    }
-    KvT[2] = KvReCo;
-
-    KvRoCe = (eeData[52] & 0x00F0) >> 4;
-    if (KvRoCe > 7) {
-        KvRoCe = KvRoCe - 16;
-    }
-    KvT[1] = KvRoCe;
-
-    KvReCe = (eeData[52] & 0x000F);
-    if (KvReCe > 7) {
-        KvReCe = KvReCe - 16;
-    }
-    KvT[3] = KvReCe;
-
-    kvScale = (eeData[56] & 0x0F00) >> 8;
-
-    for (int i = 0; i < 24; i++) {
-        for (int j = 0; j < 32; j++) {
-            p         = 32 * i + j;
-            split     = 2 * (p / 32 - (p / 64) * 2) + p % 2;
-            kvTemp[p] = KvT[split];
-            kvTemp[p] = kvTemp[p] / pow(2, (double)kvScale);
-            // kvTemp[p] = kvTemp[p] * mlx90640->offset[p];
-        }
-    }
-
-    temp = fabs(kvTemp[0]);
-    for (int i = 1; i < 768; i++) {
-        if (fabs(kvTemp[i]) > temp) {
-            temp = fabs(kvTemp[i]);
-        }
-    }
-
-    kvScale = 0;
-    while (temp < 64) {
-        temp    = temp * 2;
-        kvScale = kvScale + 1;
-    }
+int8_t RoundScaled(int value, int shift) {
+    int magnitude;
 
-    for (int i = 0; i < 768; i++) {
-        temp = kvTemp[i] * pow(2, (double)kvScale);
-        if (temp < 0) {
-            mlx90640->kv[i] = (temp - 0.5);
-        } else {
-            mlx90640->kv[i] = (temp + 0.5);
-        }
+    // value * 2^shift, rounded half away from zero.
+    magnitude = abs(value);
+    if (shift >= 0) {
+        magnitude = magnitude << shift;
+    } else {
+        magnitude = (magnitude + (1 << (-shift - 1))) >> -shift;
     }
 
-    mlx90640->kvScale = kvScale;
+    return (int8_t)(value < 0 ? -magnitude : magnitude);
 }
 
 //------------------------------------------------------------------------------
@@ -1113,7 +1862,7 @@ void ExtractCPParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
     if (alphaSP[0] > 511) {
         alphaSP[0] = alphaSP[0] - 1024;
     }
-    alphaSP[0] = alphaSP[0] / pow(2, (double)alphaScale);
+    alphaSP[0] = ldexpf(alphaSP[0], -alphaScale);
 
     alphaSP[1] = (eeData[57] & 0xFC00) >> 10;
     if (alphaSP[1] > 31) {
@@ -1126,14 +1875,14 @@ void ExtractCPParameters(uint16_t *eeData, paramsMLX90640 *mlx90640) {
         cpKta = cpKta - 256;
     }
     ktaScale1       = ((eeData[56] & 0x00F0) >> 4) + 8;
-    mlx90640->cpKta = cpKta / pow(2, (double)ktaScale1);
+    mlx90640->cpKta = ldexpf(cpKta, -ktaScale1);
 
     cpKv = (eeData[59] & 0xFF00) >> 8;
     if (cpKv > 127) {
         cpKv = cpKv - 256;
     }
     kvScale        = (eeData[56] & 0x0F00) >> 8;
-    mlx90640->cpKv = cpKv / pow(2, (double)kvScale);
+    mlx90640->cpKv = ldexpf(cpKv, -kvScale);
 
     mlx90640->cpAlpha[0]  = alphaSP[0];
     mlx90640->cpAlpha[1]  = alphaSP[1];
@@ -1298,3 +2047,395 @@ int IsPixelBad(uint16_t pixel, paramsMLX90640 *params) {
 }
 
 //------------------------------------------------------------------------------
+
+int ReadFrameData(uint8_t slaveAddr, uint16_t *frameData) {
+    uint16_t dataReady = 1;
+    uint16_t controlRegister1;
+    uint16_t statusRegister;
+    int error   = 1;
+    uint8_t cnt = 0;
+
+    while (dataReady != 0 && cnt < 5) {
+        error = MLX90640_I2CWrite(slaveAddr, 0x8000, 0x0030);
+        if (error == -1) {
+            return error;
+        }
+
+        error = MLX90640_I2CRead(slaveAddr, 0x0400, 832, frameData);
+        if (error != 0) {
+            return error;
+        }
+
+        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &statusRegister);
+        if (error != 0) {
+            return error;
+        }
+        dataReady = statusRegister & 0x0008;
+        cnt       = cnt + 1;
+    }
+
+    if (cnt > 4) {
+        return -8;
+    }
+
+    error          = ReadControlRegister1(slaveAddr, &controlRegister1);
+    frameData[832] = controlRegister1;
+    frameData[833] = statusRegister & 0x0001;
+
+    if (error != 0) {
+        return error;
+    }
+
+    return frameData[833];
+}
+
+//------------------------------------------------------------------------------
+
+void SetSchedulerRate(schedulerMLX90640 *scheduler, uint16_t controlRegister1) {
+    // 0.5Hz * 2^rate subpages
+    scheduler->controlRegister1 = controlRegister1;
+    scheduler->period       = 2000000UL >> ((controlRegister1 & 0x0380) >> 7);
+    scheduler->guard        = scheduler->period / 16;
+    scheduler->synchronized = false;
+}
+
+//------------------------------------------------------------------------------
+
+void SchedulerArrival(schedulerMLX90640 *scheduler, int polls,
+                      unsigned long lastPoll, unsigned long pollStart) {
+    uint32_t interval;
+    uint32_t subPages;
+    unsigned long arrival;
+
+    // data ready came between the last two polls. If it was there at the
+    // first one already, it's the predicted time as far as we know.
+    if (polls > 1) {
+        arrival = lastPoll + (pollStart - lastPoll) / 2;
+    } else {
+        arrival = pollStart;
+        if (scheduler->synchronized &&
+            (int32_t)(pollStart - scheduler->lastArrival - scheduler->period) >= 0) {
+            arrival = scheduler->lastArrival + scheduler->period;
+        }
+        scheduler->late++;
+    }
+
+    if (scheduler->synchronized) {
+        interval = arrival - scheduler->lastArrival;
+        subPages = (interval + scheduler->period / 2) / scheduler->period;
+        if (subPages > 1) {
+            scheduler->skipped += subPages - 1;
+        }
+        // the sensor's clock, from exactly timed arrivals only: polls at most
+        // half the guard time apart, as the backoff has them
+        if (polls > 1 && subPages > 0 &&
+            pollStart - lastPoll <= scheduler->guard / 2) {
+            scheduler->period += ((int32_t)(interval / subPages) -
+                                  (int32_t)scheduler->period) / 8;
+        }
+    }
+    scheduler->lastArrival  = arrival;
+    scheduler->synchronized = true;
+}
+
+//------------------------------------------------------------------------------
+
+void SchedulerFrame(schedulerMLX90640 *scheduler, uint16_t *frameData) {
+    scheduler->frames++;
+
+    // a new refresh rate starts over
+    if ((frameData[832] ^ scheduler->controlRegister1) & 0x0380) {
+        SetSchedulerRate(scheduler, frameData[832]);
+    }
+    scheduler->controlRegister1 = frameData[832];
+}
+
+//------------------------------------------------------------------------------
+
+shadowMLX90640 *FindShadow(uint8_t slaveAddr) {
+    shadowMLX90640 *unused = NULL;
+
+    for (int i = 0; i < MLX90640_SHADOW_SENSORS; i++) {
+        if (shadows[i].slaveAddr == slaveAddr) {
+            return &shadows[i];
+        }
+        if (shadows[i].slaveAddr == 0 && unused == NULL) {
+            unused = &shadows[i];
+        }
+    }
+
+    // more sensors than shadows go to the bus every time
+    if (unused != NULL) {
+        unused->slaveAddr = slaveAddr;
+        unused->valid     = 0;
+    }
+
+    return unused;
+}
+
+//------------------------------------------------------------------------------
+
+int ReadControlRegister1(uint8_t slaveAddr, uint16_t *controlRegister1) {
+    shadowMLX90640 *shadow = FindShadow(slaveAddr);
+    int error;
+
+    if (shadow != NULL && shadow->valid) {
+        *controlRegister1 = shadow->controlRegister1;
+        return 0;
+    }
+
+    error = MLX90640_I2CRead(slaveAddr, 0x800D, 1, controlRegister1);
+    if (error == 0 && shadow != NULL) {
+        shadow->controlRegister1 = *controlRegister1;
+        shadow->valid            = 1;
+    }
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+int WriteControlRegister1(uint8_t slaveAddr, uint16_t controlRegister1) {
+    shadowMLX90640 *shadow = FindShadow(slaveAddr);
+    int error;
+
+    error = MLX90640_I2CWrite(slaveAddr, 0x800D, controlRegister1);
+
+    // after a failed write or read back the register is unknown, it's read
+    // next time
+    if (shadow != NULL) {
+        shadow->controlRegister1 = controlRegister1;
+        shadow->valid            = (error == 0);
+    }
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+
+int IsPixelPlanned(uint16_t pixel, const correctionPlanMLX90640 *plan) {
+    for (int i = 0; i < plan->count; i++) {
+        if (plan->step[0][i].pixel == pixel) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void PlanPixel(correctionPlanMLX90640 *plan, int n) {
+    uint16_t pixel;
+    uint8_t line;
+    uint8_t column;
+    correctionStepMLX90640 *interleaved;
+    correctionStepMLX90640 *chess;
+
+    interleaved  = &plan->step[0][n];
+    chess        = &plan->step[1][n];
+    pixel        = interleaved->pixel;
+    line         = pixel >> 5;
+    column       = pixel - (line << 5);
+    chess->pixel = pixel;
+
+    // chess mode: the diagonal neighbours, which are of the same subpage.
+    if (line == 0) {
+        if (column == 0) {
+            SetCorrectionStep(chess, MLX90640_CORRECT_COPY, 33, 33, 33, 33);
+        } else if (column == 31) {
+            SetCorrectionStep(chess, MLX90640_CORRECT_COPY, 62, 62, 62, 62);
+        } else {
+            SetCorrectionStep(chess, MLX90640_CORRECT_MEAN, pixel + 31,
+                              pixel + 33, pixel + 33, pixel + 33);
+        }
+    } else if (line == 23) {
+        if (column == 0) {
+            SetCorrectionStep(chess, MLX90640_CORRECT_COPY, 705, 705, 705, 705);
+        } else if (column == 31) {
+            SetCorrectionStep(chess, MLX90640_CORRECT_COPY, 734, 734, 734, 734);
+        } else {
+            SetCorrectionStep(chess, MLX90640_CORRECT_MEAN, pixel - 33,
+                              pixel - 31, pixel - 31, pixel - 31);
+        }
+    } else if (column == 0) {
+        SetCorrectionStep(chess, MLX90640_CORRECT_MEAN, pixel - 31, pixel + 33,
+                          pixel + 33, pixel + 33);
+    } else if (column == 31) {
+        SetCorrectionStep(chess, MLX90640_CORRECT_MEAN, pixel - 33, pixel + 31,
+                          pixel + 31, pixel + 31);
+    } else {
+        SetCorrectionStep(chess, MLX90640_CORRECT_MEDIAN, pixel - 33,
+                          pixel - 31, pixel + 31, pixel + 33);
+    }
+
+    // interleaved mode: the neighbours in the line, the gradient from both
+    // sides unless one of the pixels two away is defective as well.
+    if (column == 0) {
+        SetCorrectionStep(interleaved, MLX90640_CORRECT_COPY, pixel + 1,
+                          pixel + 1, pixel + 1, pixel + 1);
+    } else if (column == 1 || column == 30) {
+        SetCorrectionStep(interleaved, MLX90640_CORRECT_MEAN, pixel - 1,
+                          pixel + 1, pixel + 1, pixel + 1);
+    } else if (column == 31) {
+        SetCorrectionStep(interleaved, MLX90640_CORRECT_COPY, pixel - 1,
+                          pixel - 1, pixel - 1, pixel - 1);
+    } else if (IsPixelPlanned(pixel - 2, plan) == 0 &&
+               IsPixelPlanned(pixel + 2, plan) == 0) {
+        SetCorrectionStep(interleaved, MLX90640_CORRECT_GRADIENT, pixel + 1,
+                          pixel + 2, pixel - 1, pixel - 2);
+    } else {
+        SetCorrectionStep(interleaved, MLX90640_CORRECT_MEAN, pixel - 1,
+                          pixel + 1, pixel + 1, pixel + 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SetCorrectionStep(correctionStepMLX90640 *step, uint8_t rule, int source0,
+                       int source1, int source2, int source3) {
+    step->rule      = rule;
+    step->source[0] = source0;
+    step->source[1] = source1;
+    step->source[2] = source2;
+    step->source[3] = source3;
+}
+
+//------------------------------------------------------------------------------
+
+void BuildPixelTables(void) {
+    int8_t ilPattern;
+    int8_t chessPattern;
+    uint16_t count[2][2] = {{0, 0}, {0, 0}};
+
+    for (int pixelNumber = 0; pixelNumber < 768; pixelNumber++) {
+        ilPattern    = pixelNumber / 32 - (pixelNumber / 64) * 2;
+        chessPattern = ilPattern ^ (pixelNumber - (pixelNumber / 2) * 2);
+        conversionPatterns[pixelNumber] =
+            ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 +
+             (pixelNumber + 1) / 4 - pixelNumber / 4) *
+            (1 - 2 * ilPattern);
+
+        activePixels[0][ilPattern][count[0][ilPattern]++]       = pixelNumber;
+        activePixels[1][chessPattern][count[1][chessPattern]++] = pixelNumber;
+    }
+
+    pixelTablesBuilt = true;
+}
+
+//------------------------------------------------------------------------------
+
+// x^(1/4) for x > 0 in float only: y = x^(-1/4), seeded from the exponent
+// bits and refined by Newton steps y = y * (5 - x * y^4) / 4, then x * y^3.
+// Relative error 5e-5 after 2 steps and 4e-7 after 3, ie. 0.015K and
+// 0.0002K at 300K. Other x as sqrt(sqrt(x)).
+float FourthRootFast(float x, int iterations) {
+    uint32_t i;
+    float y;
+
+    if (!(x > 1e-30f && x < 1e30f)) {
+        return sqrt(sqrt(x));
+    }
+
+    memcpy(&i, &x, sizeof(i));
+    i = 0x4F585F79 - (i >> 2);
+    memcpy(&y, &i, sizeof(y));
+
+    for (int n = 0; n < iterations; n++) {
+        y = y * (1.25f - 0.25f * x * (y * y) * (y * y));
+    }
+
+    return x * y * y * y;
+}
+
+//------------------------------------------------------------------------------
+
+void BuildFourthRootTable(void) {
+    for (int i = 0; i < 257; i++) {
+        fourthRootTable[i] = lrint(sqrt(sqrt(ldexp(1.0 + (i & 63) / 64.0, i >> 6))) *
+                                   1048576.0);
+    }
+
+    fourthRootTableBuilt = true;
+}
+
+//------------------------------------------------------------------------------
+
+// x^(1/4) in Q8 for integer x, from the table: x = 2^(4q + j) * (1 + f),
+// x^(1/4) = 2^q * (2^j * (1 + f))^(1/4), linear between the 64 entries per
+// octave. Relative error below 1e-5, ie. 0.003K at 300K.
+uint32_t FourthRootFixed(uint64_t x) {
+    int e;
+    int q;
+    uint32_t f;
+    uint32_t i;
+    uint32_t root;
+
+    if (x == 0) {
+        return 0;
+    }
+
+    e = 63 - __builtin_clzll(x);
+    q = e >> 2;
+    if (q > 11) {
+        return 0xFFFFFFFF;
+    }
+
+    // 22 bits below the leading one: 6 for the table, 16 to interpolate
+    f = (e >= 22 ? x >> (e - 22) : x << (22 - e)) & 0x3FFFFF;
+    i = ((e & 3) << 6) | (f >> 16);
+    f = f & 0xFFFF;
+
+    root = fourthRootTable[i] +
+           (((fourthRootTable[i + 1] - fourthRootTable[i]) * f) >> 16);
+
+    // Q20 * 2^q to Q8
+    return (root + (1 << (11 - q))) >> (12 - q);
+}
+
+//------------------------------------------------------------------------------
+
+void BuildReciprocalTable(void) {
+    for (int i = 0; i < 256; i++) {
+        reciprocalTable[i] = (1ULL << 62) / ((1ULL << 31) + ((uint64_t)i << 23) + (1 << 22));
+    }
+
+    reciprocalTableBuilt = true;
+}
+
+//------------------------------------------------------------------------------
+
+// x * 2^24 / divisor for |x| <= 2^38 and a Q24 divisor, without a division:
+// divisor = m / 2^z with m in [2^31, 2^32), r = 2^62 / m from the table and
+// one Newton step, relative error below 5e-6. The divisor is limited to
+// [2^20, 2^32), ie. 1/16 to 256, the correction factors of
+// MLX90640_CalculateToFixed() are close to 1.
+static inline int64_t DivideFixed(int64_t x, int64_t divisor) {
+    uint32_t m;
+    uint32_t r;
+    uint64_t e;
+    uint64_t a;
+    int z;
+    int64_t q;
+
+    if (divisor < (1 << 20)) {
+        divisor = 1 << 20;
+    } else if (divisor > 0xFFFFFFFFLL) {
+        divisor = 0xFFFFFFFFLL;
+    }
+
+    z = __builtin_clz((uint32_t)divisor);
+    m = (uint32_t)divisor << z;
+
+    r = reciprocalTable[(m >> 23) & 0xFF];
+    e = ((uint64_t)m * r) >> 31;                         // m * r, Q31
+    r = ((uint64_t)r * ((1ULL << 32) - e)) >> 31;
+
+    // x * r / 2^(38 - z), 64 bit products of the 22 + 16 bit halves of |x|
+    a = x < 0 ? -x : x;
+    q = (((a >> 16) * r) >> (22 - z)) + (((a & 0xFFFF) * r) >> (38 - z));
+
+    return x < 0 ? -q : q;
+}
+
+//------------------------------------------------------------------------------
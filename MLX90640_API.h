@@ -52,15 +52,247 @@ typedef struct {
     uint16_t outlierPixels[5];
 } paramsMLX90640;
 
+// To conversion of MLX90640_CalculateTo() and MLX90640_CalculateToPrepared(),
+// max errors against MLX90640_TO_EXACT, see MLX90640Bench/
+typedef enum {
+    MLX90640_TO_EXACT,       // sqrt(sqrt()) as in the Melexis driver
+    MLX90640_TO_FAST,        // float only fourth roots, max error 0.001 degC
+    MLX90640_TO_SINGLE_PASS  // skips the second root inside ct range 1,
+                             // max error 0.05 degC
+} toConversionMLX90640;
+
+// distance in degC to the ct range limits, that MLX90640_TO_SINGLE_PASS
+// keeps to skip the second root
+#define MLX90640_SINGLE_PASS_MARGIN 1.0f
+
+// pixel pattern bits of preparedMLX90640.pattern[]
+#define MLX90640_IL_PATTERN       0x01  // interleaved mode subpage
+#define MLX90640_CHESS_PATTERN    0x02  // chess mode subpage
+
+// per pixel calibration, derived once from paramsMLX90640 by
+// MLX90640_PrepareParameters(), as contiguous float planes.
+typedef struct {
+    float kta[768];     // kta / 2^ktaScale
+    float kv[768];      // kv / 2^kvScale
+    float alpha[768];   // SCALEALPHA * 2^alphaScale / alpha, ie. sensitivity
+    float offset[768];
+    uint8_t pattern[768];
+} preparedMLX90640;
+
+// everything of one raw frame (subpage), that doesn't depend on the pixel.
+// Filled once per frame by MLX90640_GetFrameContext() and
+// MLX90640_SetFrameEmissivity(), then passed to the functions below.
+typedef struct {
+    uint16_t subPage;
+    uint8_t mode;           // 0: interleaved, 0x80: chess, as calibrationModeEE
+    float vdd;
+    float ta;
+    float gain;
+    float irDataCP[2];      // compensated CP of both subpages
+    float alphaCorrR[4];
+    float emissivity;
+    float tr;
+    float taTr;             // (tr+273.15)^4 - ((tr+273.15)^4 - (ta+273.15)^4) / emissivity
+} frameContextMLX90640;
+
+// default drift of Ta (degC) and Vdd (V), that a compensatedMLX90640 ignores
+#define MLX90640_COMPENSATION_EPSILON_TA   0.05f
+#define MLX90640_COMPENSATION_EPSILON_VDD  0.005f
+
+// per pixel offset and alpha of preparedMLX90640, compensated for Ta and Vdd
+// of the frame they were built for. MLX90640_UpdateCompensation() rebuilds
+// them only if Ta or Vdd moved by more than the epsilons since.
+typedef struct {
+    float offset[768];  // offset * (1 + kta * (ta - 25)) * (1 + kv * (vdd - 3.3))
+    float alpha[768];   // alpha * (1 + KsTa * (ta - 25))
+    float ta;           // of the last rebuild
+    float vdd;
+    float epsilonTa;
+    float epsilonVdd;
+    bool valid;
+    uint32_t updates;   // calls of MLX90640_UpdateCompensation()
+    uint32_t rebuilds;  // thereof with a rebuild
+} compensatedMLX90640;
+
+// compensatedMLX90640 in integers, for MLX90640_CalculateToFixed(). Built by
+// MLX90640_UpdateFixed() from the integer kta, kv and alpha of
+// paramsMLX90640, with the same epsilons as compensatedMLX90640.
+typedef struct {
+    int32_t offset[768];        // compensated offset, Q14 counts
+    uint32_t sensitivity[768];  // 1 / compensated alpha, K^4 per count
+    float ta;                   // of the last rebuild
+    float vdd;
+    float epsilonTa;
+    float epsilonVdd;
+    bool valid;
+    uint32_t updates;           // calls of MLX90640_UpdateFixed()
+    uint32_t rebuilds;          // thereof with a rebuild
+} fixedMLX90640;
+
+// power on default of control register 1 (2Hz, chess mode), that
+// MLX90640_InitScheduler() assumes if it can't read the register
+#define MLX90640_CONTROL_REGISTER1_POR  0x1901
+
+// data ready scheduling of MLX90640_GetFrameDataScheduled(): the subpage
+// period follows the refresh rate in control register 1 and the measured
+// arrivals, so that the status register is polled only shortly before the
+// next subpage is due. Times in us of MLX90640_I2CMicros().
+typedef struct {
+    uint8_t slaveAddr;
+    uint16_t controlRegister1;  // as last read, ie. frameData[832]
+    uint32_t period;            // of a subpage, measured
+    uint32_t guard;             // polling starts this early
+    uint32_t lastArrival;       // estimated data ready of the last subpage
+    bool synchronized;          // lastArrival is known
+    uint32_t frames;
+    uint32_t polls;             // status reads
+    uint32_t idlePolls;         // thereof without data ready
+    uint32_t idleMicros;        // bus time of those
+    uint32_t sleptMicros;       // left to the caller's task
+    uint32_t late;              // frames ready at the first status read
+    uint32_t skipped;           // subpages that came and went unread
+} schedulerMLX90640;
+
+// states of acquisitionMLX90640
+#define MLX90640_ACQUISITION_IDLE      0  // not started
+#define MLX90640_ACQUISITION_WAIT      1  // for data ready
+#define MLX90640_ACQUISITION_CLEAR     2  // of data ready
+#define MLX90640_ACQUISITION_READ      3  // of the RAM, a chunk per step
+#define MLX90640_ACQUISITION_CHECK     4  // for a subpage during the read
+#define MLX90640_ACQUISITION_COMPLETE  5
+#define MLX90640_ACQUISITION_FAILED    6
+
+// us between the status reads of an acquisition without a scheduler
+#define MLX90640_ACQUISITION_BACKOFF   1000
+
+// the frame read of MLX90640_GetFrameData() in steps of at most one bus
+// transaction, so that the caller goes on in between, ie. upscales and
+// pushes a strip of the previous frame. MLX90640_StartAcquisition() begins
+// it, each MLX90640_PollAcquisition() takes the next step, from the loop or
+// a transfer complete callback, and returns 1 once the frame is in (result
+// is its subpage), 0 while it goes on, or the error. A frame takes
+// 832 / chunk + 2 steps: data ready, the chunks (the first one together
+// with the short clear of data ready) and the check for a new subpage.
+// With a scheduler, the wait for data ready takes no transaction until the
+// subpage is due, without one a status read every
+// MLX90640_ACQUISITION_BACKOFF us.
+typedef struct {
+    uint8_t slaveAddr;
+    schedulerMLX90640 *scheduler;  // or NULL: status reads at a fixed rate
+    uint16_t chunk;                // RAM words per read step
+    uint16_t *frameData;
+    uint8_t state;
+    uint8_t attempts;              // RAM reads of this subpage
+    uint16_t next;                 // RAM words read
+    uint16_t statusRegister;
+    int polls;                     // status reads of this subpage
+    uint32_t lastPoll;             // us, the last one without data ready
+    uint32_t notBefore;            // us, the next one
+    int result;                    // subpage or error, once done
+} acquisitionMLX90640;
+
+// sensors whose control register 1 is shadowed: MLX90640_GetCurMode(),
+// MLX90640_GetRefreshRate(), MLX90640_GetCurResolution() and the frame reads
+// take it from the last read or write instead of the bus. After a sensor
+// reset or writes from elsewhere, MLX90640_InvalidateShadow() reads it again.
+#ifndef MLX90640_SHADOW_SENSORS
+#define MLX90640_SHADOW_SENSORS 4
+#endif
+
+// defective pixels a correctionPlanMLX90640 holds: the 5 + 5 broken and
+// outlier ones of the EEPROM and more flagged by the user
+#define MLX90640_PLAN_PIXELS 32
+
+// rules of correctionStepMLX90640, as MLX90640_BadPixelsCorrection() has them
+#define MLX90640_CORRECT_COPY      0  // source[0]
+#define MLX90640_CORRECT_MEAN      1  // (source[0] + source[1]) / 2
+#define MLX90640_CORRECT_MEDIAN    2  // median of source[0..3]
+#define MLX90640_CORRECT_GRADIENT  3  // source[0] or source[2] continued by
+                                      // the smaller of their steps from
+                                      // source[1] and source[3]
+
+// replacement of one defective pixel in one readout mode
+typedef struct {
+    uint16_t pixel;
+    uint8_t rule;
+    uint16_t source[4];
+} correctionStepMLX90640;
+
+// the pixel corrections of MLX90640_BadPixelsCorrection(), compiled once by
+// MLX90640_BuildCorrectionPlan() with each pixel's neighbours resolved, for
+// MLX90640_ApplyCorrectionPlan() on every frame. Steps run in order, so a
+// corrected pixel may be the source of a later one.
+typedef struct {
+    uint16_t count;
+    correctionStepMLX90640 step[2][MLX90640_PLAN_PIXELS];  // [0: interleaved,
+                                                           //  1: chess mode]
+} correctionPlanMLX90640;
+
 int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData);
 int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData);
+int MLX90640_InitScheduler(uint8_t slaveAddr, schedulerMLX90640 *scheduler);
+uint32_t MLX90640_SchedulerIdleTime(const schedulerMLX90640 *scheduler);
+int MLX90640_GetFrameDataScheduled(schedulerMLX90640 *scheduler,
+                                   uint16_t *frameData);
+void MLX90640_InitAcquisition(acquisitionMLX90640 *acquisition,
+                              uint8_t slaveAddr, schedulerMLX90640 *scheduler,
+                              uint16_t chunkWords);
+void MLX90640_StartAcquisition(acquisitionMLX90640 *acquisition,
+                               uint16_t *frameData);
+int MLX90640_PollAcquisition(acquisitionMLX90640 *acquisition);
+int MLX90640_IsAcquisitionComplete(const acquisitionMLX90640 *acquisition);
+uint32_t MLX90640_AcquisitionIdleTime(const acquisitionMLX90640 *acquisition);
+int MLX90640_CompleteAcquisition(acquisitionMLX90640 *acquisition);
 int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 float MLX90640_GetVdd(uint16_t *frameData, const paramsMLX90640 *params);
 float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params);
+float MLX90640_GetTa(const frameContextMLX90640 *context);
+void MLX90640_GetFrameContext(uint16_t *frameData, const paramsMLX90640 *params,
+                              frameContextMLX90640 *context);
+void MLX90640_SetFrameEmissivity(frameContextMLX90640 *context,
+                                 float emissivity, float tr);
 void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params,
                        float *result);
+void MLX90640_GetImage(uint16_t *frameData, const paramsMLX90640 *params,
+                       const frameContextMLX90640 *context, float *result);
 void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
                           float emissivity, float tr, float *result);
+void MLX90640_CalculateTo(uint16_t *frameData, const paramsMLX90640 *params,
+                          const frameContextMLX90640 *context, float *result);
+void MLX90640_SetToConversion(toConversionMLX90640 mode);
+void MLX90640_PrepareParameters(const paramsMLX90640 *params,
+                                preparedMLX90640 *prepared);
+void MLX90640_CalculateToPrepared(uint16_t *frameData,
+                                  const paramsMLX90640 *params,
+                                  const preparedMLX90640 *prepared,
+                                  float emissivity, float tr, float *result);
+void MLX90640_CalculateToPrepared(uint16_t *frameData,
+                                  const paramsMLX90640 *params,
+                                  const preparedMLX90640 *prepared,
+                                  const frameContextMLX90640 *context,
+                                  float *result);
+void MLX90640_InitCompensation(compensatedMLX90640 *compensated,
+                               float epsilonTa, float epsilonVdd);
+int MLX90640_UpdateCompensation(const preparedMLX90640 *prepared,
+                                const paramsMLX90640 *params,
+                                const frameContextMLX90640 *context,
+                                compensatedMLX90640 *compensated);
+void MLX90640_CalculateToCompensated(uint16_t *frameData,
+                                     const paramsMLX90640 *params,
+                                     const preparedMLX90640 *prepared,
+                                     compensatedMLX90640 *compensated,
+                                     const frameContextMLX90640 *context,
+                                     float *result);
+void MLX90640_InitFixed(fixedMLX90640 *fixed, float epsilonTa, float epsilonVdd);
+int MLX90640_UpdateFixed(const paramsMLX90640 *params,
+                         const frameContextMLX90640 *context,
+                         fixedMLX90640 *fixed);
+void MLX90640_CalculateToFixed(uint16_t *frameData,
+                                const paramsMLX90640 *params,
+                                const preparedMLX90640 *prepared,
+                                fixedMLX90640 *fixed,
+                                const frameContextMLX90640 *context,
+                                int16_t *result);
 int MLX90640_SetResolution(uint8_t slaveAddr, uint8_t resolution);
 int MLX90640_GetCurResolution(uint8_t slaveAddr);
 int MLX90640_SetRefreshRate(uint8_t slaveAddr, uint8_t refreshRate);
@@ -69,7 +301,19 @@ int MLX90640_GetSubPageNumber(uint16_t *frameData);
 int MLX90640_GetCurMode(uint8_t slaveAddr);
 int MLX90640_SetInterleavedMode(uint8_t slaveAddr);
 int MLX90640_SetChessMode(uint8_t slaveAddr);
+void MLX90640_InvalidateShadow(uint8_t slaveAddr);
 void MLX90640_BadPixelsCorrection(uint16_t *pixels, float *to, int mode,
                                   paramsMLX90640 *params);
+void MLX90640_BadPixelsCorrection(uint16_t *pixels, float *to,
+                                  const frameContextMLX90640 *context,
+                                  paramsMLX90640 *params);
+int MLX90640_BuildCorrectionPlan(const paramsMLX90640 *params,
+                                 const uint16_t *userPixels, int userCount,
+                                 correctionPlanMLX90640 *plan);
+void MLX90640_ApplyCorrectionPlan(const correctionPlanMLX90640 *plan,
+                                  float *to, int mode);
+void MLX90640_ApplyCorrectionPlan(const correctionPlanMLX90640 *plan,
+                                  float *to,
+                                  const frameContextMLX90640 *context);
 
 #endif
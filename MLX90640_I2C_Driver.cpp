@@ -16,82 +16,275 @@
 */
 #include "MLX90640_I2C_Driver.h"
 
+#include <stddef.h>
+#ifdef ARDUINO
 #include <Arduino.h>
 #include <Wire.h>
+#endif
+
+// default bytes per read transaction, see MLX90640_I2CSetBurstLength()
+#ifndef MLX90640_I2C_BURST_LENGTH
+#define MLX90640_I2C_BURST_LENGTH I2C_BUFFER_LENGTH
+#endif
+
+// attempts more of a transaction the sensor didn't ack
+#ifndef MLX90640_I2C_RETRIES
+#define MLX90640_I2C_RETRIES 2
+#endif
+
+// MLX90640_VERIFY_..., see MLX90640_I2CSetWriteVerify()
+#ifndef MLX90640_I2C_WRITE_VERIFY
+#define MLX90640_I2C_WRITE_VERIFY MLX90640_VERIFY_CONFIG
+#endif
+
+// NULL: Wire
+static const i2cTransportMLX90640 *transport = NULL;
+static unsigned int burstLength = MLX90640_I2C_BURST_LENGTH;
+static i2cStatsMLX90640 stats;
+static int writeVerify = MLX90640_I2C_WRITE_VERIFY;
+
 
 void MLX90640_I2CInit() {
 }
 
+void MLX90640_I2CSetTransport(const i2cTransportMLX90640 *newTransport) {
+    transport = newTransport;
+}
+
+// The read back costs a transaction per write. The status register never
+// reads back as written (subpage and data ready are the sensor's), so by
+// default only the configuration registers are verified.
+void MLX90640_I2CSetWriteVerify(int policy) {
+    writeVerify = policy;
+}
+
+#ifdef ARDUINO
+// Read one burst of words from startAddress, a single address phase.
+// Returns 0 if successful, -1 if the sensor didn't ack or sent less
+static int WireRead(uint8_t _deviceAddress, unsigned int startAddress,
+                    unsigned int nWordsRead, uint16_t *data) {
+    uint8_t *bytes = (uint8_t *)data;
+    size_t numberOfBytesToRead = nWordsRead * 2;
+    size_t received;
+
+    Wire.beginTransmission(_deviceAddress);
+    Wire.write(startAddress >> 8);         // MSB
+    Wire.write(startAddress & 0xFF);       // LSB
+    if (Wire.endTransmission(false) != 0)  // Do not release bus
+    {
+        return (-1);  // Sensor did not ACK
+    }
+
+#ifdef ARDUINO_ARCH_ESP32
+    // the size_t one, the others return an uint8_t count
+    received = Wire.requestFrom((uint8_t)_deviceAddress, numberOfBytesToRead,
+                                true);
+#else
+    received = Wire.requestFrom((int)_deviceAddress, (int)numberOfBytesToRead);
+#endif
+    if (received != numberOfBytesToRead ||
+        Wire.readBytes(bytes, numberOfBytesToRead) != numberOfBytesToRead) {
+        return (-1);
+    }
+
+    // big endian words, in place
+    for (size_t x = 0; x < nWordsRead; x++) {
+        data[x] = (bytes[2 * x] << 8) | bytes[2 * x + 1];
+    }
+
+    return (0);  // Success
+}
+
+// Write two bytes to a two byte address
+static int WireWrite(uint8_t _deviceAddress, unsigned int writeAddress,
+                     uint16_t data) {
+    Wire.beginTransmission((uint8_t)_deviceAddress);
+    Wire.write(writeAddress >> 8);    // MSB
+    Wire.write(writeAddress & 0xFF);  // LSB
+    Wire.write(data >> 8);            // MSB
+    Wire.write(data & 0xFF);          // LSB
+    if (Wire.endTransmission() != 0) {
+        // Sensor did not ACK
+        return (-1);
+    }
+
+    return (0);
+}
+
+#else
+// host builds have no Wire; without a transport there's no sensor.
+static int WireRead(uint8_t, unsigned int, unsigned int, uint16_t *) {
+    return (-1);
+}
+
+static int WireWrite(uint8_t, unsigned int, uint16_t) {
+    return (-1);
+}
+
+#endif
+
+// the transport's clock if it has one, else the Arduino one
+unsigned long MLX90640_I2CMicros(void) {
+    if (transport != NULL && transport->micros != NULL) {
+        return transport->micros(transport->context);
+    }
+#ifdef ARDUINO
+    return micros();
+#else
+    return 0;
+#endif
+}
+
+// long waits in ms, so that other tasks run meanwhile
+void MLX90640_I2CDelay(unsigned long us) {
+    if (transport != NULL && transport->delay != NULL) {
+        transport->delay(transport->context, us);
+        return;
+    }
+#ifdef ARDUINO
+    if (us >= 2000) {
+        delay(us / 1000);
+        us = us % 1000;
+    }
+    delayMicroseconds(us);
+#endif
+}
+
 // Read a number of words from startAddress. Store into Data array.
 // Returns 0 if successful, -1 if error
 int MLX90640_I2CRead(uint8_t _deviceAddress, unsigned int startAddress,
                      unsigned int nWordsRead, uint16_t *data) {
-    // Caller passes number of 'unsigned ints to read', increase this to 'bytes
-    // to read'
-    uint16_t bytesRemaining = nWordsRead * 2;
-
-    // It doesn't look like sequential read works. Do we need to re-issue the
-    // address command each time?
-
-    uint16_t dataSpot = 0;  // Start at beginning of array
-
-    // Setup a series of chunked I2C_BUFFER_LENGTH byte reads
-    while (bytesRemaining > 0) {
-        Wire.beginTransmission(_deviceAddress);
-        Wire.write(startAddress >> 8);         // MSB
-        Wire.write(startAddress & 0xFF);       // LSB
-        if (Wire.endTransmission(false) != 0)  // Do not release bus
-        {
-            Serial.println("No ack read");
-            return (0);  // Sensor did not ACK
-        }
+    unsigned long start = MLX90640_I2CMicros();
+    unsigned int burstWords = burstLength / 2;
+    unsigned int words;
+    int error = 0;
 
-        uint16_t numberOfBytesToRead = bytesRemaining;
-        if (numberOfBytesToRead > I2C_BUFFER_LENGTH)
-            numberOfBytesToRead = I2C_BUFFER_LENGTH;
+    // The sensor auto increments the address, so each burst of up to
+    // burstLength bytes takes one address phase.
+    while (nWordsRead > 0 && error == 0) {
+        words = nWordsRead < burstWords ? nWordsRead : burstWords;
 
-        Wire.requestFrom((uint8_t)_deviceAddress, (uint8_t)numberOfBytesToRead);
-        if (Wire.available()) {
-            for (uint16_t x = 0; x < numberOfBytesToRead / 2; x++) {
-                // Store data into array
-                data[dataSpot] = Wire.read() << 8;  // MSB
-                data[dataSpot] |= Wire.read();      // LSB
-
-                dataSpot++;
+        for (int attempt = 0; attempt <= MLX90640_I2C_RETRIES; attempt++) {
+            if (attempt > 0) {
+                stats.retries++;
+            }
+            stats.transactions++;
+            if (transport != NULL) {
+                error = transport->read(transport->context, _deviceAddress,
+                                        startAddress, words, data);
+            } else {
+                error = WireRead(_deviceAddress, startAddress, words, data);
+            }
+            if (error == 0) {
+                break;
             }
         }
 
-        bytesRemaining -= numberOfBytesToRead;
-
-        startAddress += numberOfBytesToRead / 2;
+        if (error == 0) {
+            stats.bytes += 2 * words;
+            nWordsRead   -= words;
+            startAddress += words;
+            data += words;
+        } else {
+            stats.errors++;
+        }
     }
 
-    return (0);  // Success
+    stats.micros += MLX90640_I2CMicros() - start;
+    return error;
 }
 
 // Set I2C Freq, in kHz
 // MLX90640_I2CFreqSet(1000) sets frequency to 1MHz
 void MLX90640_I2CFreqSet(int freq) {
+    if (transport != NULL) {
+        transport->freqSet(transport->context, freq);
+        return;
+    }
+#ifdef ARDUINO
     // i2c.frequency(1000 * freq);
     Wire.setClock((long)1000 * freq);
+#endif
 }
 
-// Write two bytes to a two byte address
+unsigned int MLX90640_I2CSetBurstLength(unsigned int bytes) {
+    bytes = bytes & ~1u;
+    if (bytes < 2) {
+        bytes = 2;
+    }
+
+    // transports take any length, Wire what its buffer holds.
+#if defined(ARDUINO_ARCH_ESP32) && ESP_ARDUINO_VERSION_MAJOR >= 2
+    // the buffer can grow, but only before Wire.begin()
+    if (transport == NULL && bytes > MLX90640_I2C_BURST_LENGTH &&
+        Wire.setBufferSize(bytes) < bytes) {
+        return burstLength;
+    }
+#else
+    if (transport == NULL && bytes > MLX90640_I2C_BURST_LENGTH) {
+        bytes = MLX90640_I2C_BURST_LENGTH;
+    }
+#endif
+
+    burstLength = bytes;
+    return burstLength;
+}
+
+void MLX90640_I2CGetStats(i2cStatsMLX90640 *copy) {
+    *copy = stats;
+}
+
+void MLX90640_I2CResetStats(void) {
+    stats.transactions = 0;
+    stats.bytes        = 0;
+    stats.retries      = 0;
+    stats.errors       = 0;
+    stats.micros       = 0;
+}
+
+// Write two bytes to a two byte address, and read them back as the write
+// verify policy says.
+// Returns 0 if successful, -1 if the sensor didn't ack the write or the read
+// back, -2 if the read back value differs
 int MLX90640_I2CWrite(uint8_t _deviceAddress, unsigned int writeAddress,
                       uint16_t data) {
-    Wire.beginTransmission((uint8_t)_deviceAddress);
-    Wire.write(writeAddress >> 8);    // MSB
-    Wire.write(writeAddress & 0xFF);  // LSB
-    Wire.write(data >> 8);            // MSB
-    Wire.write(data & 0xFF);          // LSB
-    if (Wire.endTransmission() != 0) {
-        // Sensor did not ACK
-        Serial.println("Error: Sensor did not ack");
+    unsigned long start = MLX90640_I2CMicros();
+    int error;
+
+    for (int attempt = 0; attempt <= MLX90640_I2C_RETRIES; attempt++) {
+        if (attempt > 0) {
+            stats.retries++;
+        }
+        stats.transactions++;
+        if (transport != NULL) {
+            error = transport->write(transport->context, _deviceAddress,
+                                     writeAddress, data);
+        } else {
+            error = WireWrite(_deviceAddress, writeAddress, data);
+        }
+        if (error == 0) {
+            break;
+        }
+    }
+
+    stats.micros += MLX90640_I2CMicros() - start;
+    if (error != 0) {
+        stats.errors++;
         return (-1);
     }
+    stats.bytes += 2;
 
-    uint16_t dataCheck;
-    MLX90640_I2CRead(_deviceAddress, writeAddress, 1, &dataCheck);
+    if (writeVerify == MLX90640_VERIFY_NEVER ||
+        (writeVerify == MLX90640_VERIFY_CONFIG && writeAddress == 0x8000)) {
+        return (0);
+    }
+
+    // a read back that failed verifies nothing
+    uint16_t dataCheck = 0;
+    error = MLX90640_I2CRead(_deviceAddress, writeAddress, 1, &dataCheck);
+    if (error != 0) {
+        return error;
+    }
     if (dataCheck != data) {
         // Serial.println("The write request didn't stick");
         return -2;
@@ -35,7 +35,8 @@
 // Teensy
 
 #elif ARDUINO_ARCH_ESP32
-// ESP32 based platforms
+// ESP32 based platforms, I2C_BUFFER_LENGTH is defined in Wire.h (128); from
+// core 2.0 on MLX90640_I2CSetBurstLength() can enlarge it before Wire.begin()
 
 #else
 
@@ -45,10 +46,47 @@
 #endif
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+// the bus behind MLX90640_I2CRead() and MLX90640_I2CWrite(): Wire on
+// Arduino unless another one is set, ie. a simulated sensor in host builds.
+// read (one transaction) and write return 0, or -1 if the sensor didn't ack;
+// micros and delay, if not NULL, are the transport's clock, ie. a simulated
+// one. context is passed through.
+typedef struct {
+    int (*read)(void *context, uint8_t slaveAddr, unsigned int startAddress,
+                unsigned int nWordsRead, uint16_t *data);
+    int (*write)(void *context, uint8_t slaveAddr, unsigned int writeAddress,
+                 uint16_t data);
+    void (*freqSet)(void *context, int freq);
+    unsigned long (*micros)(void *context);
+    void (*delay)(void *context, unsigned long us);
+    void *context;
+} i2cTransportMLX90640;
+
+// which MLX90640_I2CWrite()s read the register back to verify it
+#define MLX90640_VERIFY_ALWAYS  0
+#define MLX90640_VERIFY_CONFIG  1  // all but the status register 0x8000
+#define MLX90640_VERIFY_NEVER   2
+
+// bus accounting of MLX90640_I2CRead() and MLX90640_I2CWrite()
+typedef struct {
+    uint32_t transactions;  // address phases, including retries
+    uint32_t bytes;         // data read and written
+    uint32_t retries;       // transactions repeated after a missing ack
+    uint32_t errors;        // reads and writes given up
+    uint32_t micros;        // time spent in both
+} i2cStatsMLX90640;
+
 void MLX90640_I2CInit(void);
 int MLX90640_I2CRead(uint8_t slaveAddr, unsigned int startAddress,
                      unsigned int nWordsRead, uint16_t *data);
 int MLX90640_I2CWrite(uint8_t slaveAddr, unsigned int writeAddress,
                       uint16_t data);
 void MLX90640_I2CFreqSet(int freq);
+void MLX90640_I2CSetTransport(const i2cTransportMLX90640 *transport);
+void MLX90640_I2CSetWriteVerify(int policy);
+unsigned int MLX90640_I2CSetBurstLength(unsigned int bytes);
+void MLX90640_I2CGetStats(i2cStatsMLX90640 *stats);
+void MLX90640_I2CResetStats(void);
+unsigned long MLX90640_I2CMicros(void);
+void MLX90640_I2CDelay(unsigned long us);
 #endif
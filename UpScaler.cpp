@@ -1,145 +1,314 @@
 #include "UpScaler.h"
-#include <math.h>
+#include <cstddef>
 #pragma GCC optimize ("O3")
 
-void Upscaler::SetInputImage(float* Image, uint16_t Width, uint16_t Height) {
-  InputImage  = Image;
-  InputWidth  = Width;
-  InputHeight = Height;
+Upscaler::Upscaler(void) :
+  InputWidth(0), InputHeight(0), Border(UpscalerBorder::Replicate), PaddedInput(NULL),
+  Sampling(UpscalerSampling::EdgeToEdge), ColPeriod(0),
+  OutputImage(NULL), OutputWidth(0), OutputHeight(0),
+  TableKernel(UpscalerKernel::None), ColTaps(NULL), RowTaps(NULL), HorzPass(NULL),
+  Ring(NULL), StripRow(0), StripKernel(UpscalerKernel::None),
+  VectorRow(UpscalerHorizontalRow(UpscalerBestISA())), ColBlocks(NULL), ColBlocksOk(false),
+  Pool(NULL), BandHorzPass(NULL),
+  PaddedInputQ14(NULL), TableKernelQ14(UpscalerKernel::None), ColTapsQ14(NULL), RowTapsQ14(NULL),
+  HorzPassQ14(NULL) {}
+
+Upscaler::~Upscaler(void) {
+  delete[] PaddedInput;
+  delete[] PaddedInputQ14;
+  FreeTables();
+}
+
+void Upscaler::SetInputImage(const float* Image, uint16_t Width, uint16_t Height) {
+  if ((Width != InputWidth) || (Height != InputHeight)) {
+     InputWidth  = Width;
+     InputHeight = Height;
+     InputGeometryChanged();
+     }
+
+  if (!Image || !Width || !Height)
+     return;
 
-  InputLastCol = InputWidth - 1;
-  InputLastRow = InputHeight - 1;
+  if (!PaddedInput)
+     PaddedInput = new float[PaddedSize()];
+  PadImage(Image, Width, Height, PaddedInput, Border);
+}
+
+void Upscaler::SetInputImage(const int16_t* Image, uint16_t Width, uint16_t Height) {
+  if ((Width != InputWidth) || (Height != InputHeight)) {
+     InputWidth  = Width;
+     InputHeight = Height;
+     InputGeometryChanged();
+     }
+
+  if (!Image || !Width || !Height)
+     return;
+
+  if (!PaddedInputQ14)
+     PaddedInputQ14 = new int16_t[PaddedSize()];
+  PadImage(Image, Width, Height, PaddedInputQ14, Border);
+}
+
+void Upscaler::SetBorderMode(UpscalerBorder Mode) {
+  Border = Mode;
 }
 
 void Upscaler::SetOutputImage(float* Image, uint16_t Width, uint16_t Height) {
+  bool Changed = (Width != OutputWidth) || (Height != OutputHeight);
+
   OutputImage  = Image;
   OutputWidth  = Width;
   OutputHeight = Height;
 
-  OutputLastCol = OutputWidth - 1;
-  OutputLastRow = OutputHeight - 1;
+  if (Changed)
+     FreeTables();
 }
 
-float CubicHermite(float A, float B, float C, float D, float t) {
-  float a = -0.5f * (A - 3.0f * B  + 3.0f * C - D);
-  float b =          A - 2.5f * B  + 2.0f * C - 0.5f * D;
-  float c = -0.5f *  A             + 0.5f * C;
-  float d = B;
+void Upscaler::SetSampling(UpscalerSampling Mode) {
+  if (Mode != Sampling) {
+     Sampling = Mode;
+     FreeTables();
+     }
+}
 
-  return a*t*t*t + b*t*t + c*t + d;
+void Upscaler::SetISA(UpscalerISA isa) {
+  VectorRow = UpscalerHorizontalRow(isa);
 }
 
-int Constrain(int V, int Min, int Max) {
-  if (V < Min)
-     return Min;
-  if (V > Max)
-     return Max;
-  return V;
+void Upscaler::SetThreadPool(UpscalerPool* Pool) {
+  if (Pool != this->Pool) {
+     delete[] BandHorzPass;
+     BandHorzPass = NULL;
+     }
+  this->Pool = Pool;
 }
 
-const float Upscaler::GetPixel(int x, int y) {
-  int pos = (Constrain(y, 0, InputLastRow) * InputWidth) + Constrain(x, 0, InputLastCol);
-  return InputImage[pos];
+uint32_t Upscaler::PaddedSize(void) {
+  return (InputWidth + 2 * UpscalerPad) * (InputHeight + 2 * UpscalerPad);
 }
 
-float Upscaler::SampleBicubic(float x_fraction, float y_fraction) {
-  float x = x_fraction * InputWidth;
-  float y = y_fraction * InputHeight;
+void Upscaler::InputGeometryChanged(void) {
+  delete[] PaddedInput;    PaddedInput    = NULL;
+  delete[] PaddedInputQ14; PaddedInputQ14 = NULL;
+  FreeTables();
+}
 
-  int xint = int(x);
-  int yint = int(y);
+void Upscaler::FreeTables(void) {
+  delete[] ColTaps;  ColTaps  = NULL;
+  delete[] RowTaps;  RowTaps  = NULL;
+  delete[] HorzPass; HorzPass = NULL;
+  delete[] Ring;     Ring     = NULL;
+  delete[] BandHorzPass; BandHorzPass = NULL;
+  delete[] ColBlocks; ColBlocks = NULL;
+  TableKernel = UpscalerKernel::None;
+  StripKernel = UpscalerKernel::None;
+
+  delete[] ColTapsQ14;  ColTapsQ14  = NULL;
+  delete[] RowTapsQ14;  RowTapsQ14  = NULL;
+  delete[] HorzPassQ14; HorzPassQ14 = NULL;
+  TableKernelQ14 = UpscalerKernel::None;
+}
 
-  float remainder = x - floorf(x);
+/* tables and buffers are allocated on first use after a geometry change,
+ * tables are rebuilt whenever the kernel changes.
+ */
+template<class Kernel>
+bool Upscaler::PrepareTables(void) {
+  if (!PaddedInput || !OutputWidth || !OutputHeight)
+     return false;
+
+  if (!ColTaps) {
+     ColTaps = new UpscalerTap<4>[OutputWidth];
+     RowTaps = new UpscalerTap<4>[OutputHeight];
+     }
 
-  // interpolate bi-cubically
-  float col0  = CubicHermite(GetPixel(xint - 1, yint - 1), GetPixel(xint + 0, yint - 1), GetPixel(xint + 1, yint - 1), GetPixel(xint + 2, yint - 1), remainder);
-  float col1  = CubicHermite(GetPixel(xint - 1, yint + 0), GetPixel(xint + 0, yint + 0), GetPixel(xint + 1, yint + 0), GetPixel(xint + 2, yint + 0), remainder);
-  float col2  = CubicHermite(GetPixel(xint - 1, yint + 1), GetPixel(xint + 0, yint + 1), GetPixel(xint + 1, yint + 1), GetPixel(xint + 2, yint + 1), remainder);
-  float col3  = CubicHermite(GetPixel(xint - 1, yint + 2), GetPixel(xint + 0, yint + 2), GetPixel(xint + 1, yint + 2), GetPixel(xint + 2, yint + 2), remainder);
+  if (TableKernel != Kernel::Id) {
+     for(uint16_t x = 0; x < OutputWidth; x++)
+        BuildTap<Kernel>(ColTaps[x], x, OutputWidth, InputWidth, Sampling);
+     for(uint16_t y = 0; y < OutputHeight; y++)
+        BuildTap<Kernel>(RowTaps[y], y, OutputHeight, InputHeight, Sampling);
+     ColPeriod   = UpscalerPeriod(OutputWidth, InputWidth, Sampling);
+     TableKernel = Kernel::Id;
+     delete[] ColBlocks; ColBlocks = NULL;
+     }
 
-  return CubicHermite(col0, col1, col2, col3, y - floorf(y));
+  if (VectorRow && !ColBlocks) {
+     ColBlocks   = new UpscalerTapBlock[OutputWidth / 8 + 1];
+     ColBlocksOk = BuildTapBlocks<Kernel>(ColTaps, OutputWidth, InputWidth + 2 * UpscalerPad, ColBlocks);
+     }
+  return true;
 }
 
-float Upscaler::SampleBilinear(float x_fraction, float y_fraction) {
-  float x = x_fraction * InputWidth;
-  float y = y_fraction * InputHeight;
+UpscalerHorizontal Upscaler::Horizontal(void) {
+  return UpscalerHorizontal(ColPeriod, VectorRow && ColBlocksOk ? VectorRow : NULL, ColBlocks);
+}
 
-  int xint = int(x);
-  int yint = int(y);
+template<class Kernel, class T, class Store>
+void Upscaler::Resize(T* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h, const Store& Output) {
+  if (!PrepareTables<Kernel>())
+     return;
 
-  float remainder = x - floorf(x);
+  if (!HorzPass)
+     HorzPass = new float[(InputHeight + 2 * UpscalerPad) * OutputWidth];
 
-  #define Lerp(A,B,t) (   (A) + (t)*((B) - (A))   )
-  float col0 = Lerp(GetPixel(xint + 0, yint + 0), GetPixel(xint + 1, yint + 0), remainder);
-  float col1 = Lerp(GetPixel(xint + 0, yint + 1), GetPixel(xint + 1, yint + 1), remainder);
-  return Lerp(col0, col1, y - floorf(y));
-  #undef Lerp
+  SeparableResize<Kernel>(PaddedInput, InputWidth + 2 * UpscalerPad, ColTaps, RowTaps, Horizontal(),
+                          HorzPass, OutputWidth, Dest, X, Y, w, h, Output);
 }
 
-float Upscaler::SampleNearest(float x_fraction, float y_fraction) {
-  int xint = int(x_fraction * InputWidth);
-  int yint = int(y_fraction * InputHeight);
-  return GetPixel(xint, yint);
+/* bands of (nearly) equal height, each on its own HorzPass, so that
+ * the bands' input rows may overlap. Tables are prepared up front, the
+ * workers only read them.
+ */
+template<class Kernel>
+void Upscaler::ResizeBands(void) {
+  if (!PrepareTables<Kernel>())
+     return;
+
+  uint8_t  Threads = Pool->Threads();
+  uint16_t Bands   = Threads < OutputHeight ? Threads : OutputHeight;
+  uint32_t Size    = (InputHeight + 2 * UpscalerPad) * OutputWidth;
+  if (!BandHorzPass)
+     BandHorzPass = new float[Threads * Size];
+
+  UpscalerHorizontal Pass = Horizontal();
+  Pool->Run(Bands, [&](uint16_t Band, uint8_t Thread) {
+     uint16_t Y = (uint32_t) OutputHeight *  Band      / Bands;
+     uint16_t h = (uint32_t) OutputHeight * (Band + 1) / Bands - Y;
+     SeparableResize<Kernel>(PaddedInput, InputWidth + 2 * UpscalerPad, ColTaps, RowTaps, Pass,
+                             BandHorzPass + Thread * Size, OutputWidth,
+                             OutputImage + Y * OutputWidth, 0, Y, OutputWidth, h);
+     });
 }
 
-void Upscaler::Resize(float (Upscaler::*Sample)(float x_fraction, float y_fraction)) {
-  if (!OutputImage)
-     return;
+template<class Kernel, class T, class Store>
+uint16_t Upscaler::Stream(T* Dest, uint16_t n, const Store& Output) {
+  if (TableKernel != Kernel::Id) {
+     // tables were rebuilt for another kernel in between: ring is stale.
+     for(uint8_t i = 0; i < 4; i++)
+        RingRow[i] = -1;
+     }
 
-  float* CurrentRow = OutputImage;
+  if (!PrepareTables<Kernel>())
+     return 0;
 
-  for(uint16_t y = 0; y < OutputHeight; y++) {
-     float* NextPixel = CurrentRow;
-     float y_fraction = y / float(OutputLastRow);
+  if (!Ring)
+     Ring = new float[4 * OutputWidth];
 
-     for(uint16_t x = 0; x < OutputWidth; x++) {
-        *NextPixel++ = (this->*Sample)(x / float(OutputLastCol), y_fraction);
-        }
+  return StreamRows<Kernel>(PaddedInput, InputWidth + 2 * UpscalerPad, ColTaps, RowTaps, Horizontal(),
+                            Ring, RingRow, OutputWidth, OutputHeight, StripRow, Dest, n, Output);
+}
 
-     CurrentRow += OutputWidth;
+template<class T, class Store>
+uint16_t Upscaler::Stream(T* Dest, uint16_t n, const Store& Output) {
+  switch(StripKernel) {
+     case UpscalerKernel::Nearest:  return Stream<NearestKernel> (Dest, n, Output);
+     case UpscalerKernel::Bilinear: return Stream<BilinearKernel>(Dest, n, Output);
+     case UpscalerKernel::Bicubic:  return Stream<BicubicKernel> (Dest, n, Output);
+     default:                       return 0;
      }
 }
 
-void Upscaler::Resize(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
-                      float (Upscaler::*Sample)(float x_fraction, float y_fraction)) {
-  float* CurrentRow = ImgPart;
-
-  uint16_t xmax = X+w;
-  uint16_t ymax = Y+h;
-
-  for(uint16_t y = Y; y < ymax; y++) {
-     float* NextPixel = CurrentRow;
-     float y_fraction = y / float(OutputLastRow);
+template<class Kernel>
+void Upscaler::Resize(int16_t* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  if (!PaddedInputQ14 || !OutputWidth || !OutputHeight)
+     return;
 
-     for(uint16_t x = X; x < xmax; x++) {
-        *NextPixel++ = (this->*Sample)(x / float(OutputLastCol), y_fraction);
-        }
+  if (!HorzPassQ14) {
+     ColTapsQ14  = new UpscalerTapQ14<4>[OutputWidth];
+     RowTapsQ14  = new UpscalerTapQ14<4>[OutputHeight];
+     HorzPassQ14 = new int32_t[(InputHeight + 2 * UpscalerPad) * OutputWidth];
+     }
 
-     CurrentRow += w;
+  if (TableKernelQ14 != Kernel::Id) {
+     for(uint16_t x = 0; x < OutputWidth; x++)
+        BuildTapQ14<Kernel>(ColTapsQ14[x], x, OutputWidth, InputWidth, Sampling);
+     for(uint16_t y = 0; y < OutputHeight; y++)
+        BuildTapQ14<Kernel>(RowTapsQ14[y], y, OutputHeight, InputHeight, Sampling);
+     TableKernelQ14 = Kernel::Id;
      }
 
+  SeparableResizeQ14<Kernel>(PaddedInputQ14, InputWidth + 2 * UpscalerPad, ColTapsQ14, RowTapsQ14,
+                             HorzPassQ14, OutputWidth, Dest, X, Y, w, h);
 }
 
 void Upscaler::ResizeBicubic(void) {
-  Resize(&Upscaler::SampleBicubic);
+  if (!OutputImage)
+     return;
+  if (Pool)
+     ResizeBands<BicubicKernel>();
+  else
+     Resize<BicubicKernel>(OutputImage, 0, 0, OutputWidth, OutputHeight, UpscalerFloat());
 }
 
 void Upscaler::ResizeBilinear(void) {
-  Resize(&Upscaler::SampleBilinear);
+  if (!OutputImage)
+     return;
+  if (Pool)
+     ResizeBands<BilinearKernel>();
+  else
+     Resize<BilinearKernel>(OutputImage, 0, 0, OutputWidth, OutputHeight, UpscalerFloat());
 }
 
 void Upscaler::ResizeNearest(void) {
-  Resize(&Upscaler::SampleNearest);
+  if (!OutputImage)
+     return;
+  if (Pool)
+     ResizeBands<NearestKernel>();
+  else
+     Resize<NearestKernel>(OutputImage, 0, 0, OutputWidth, OutputHeight, UpscalerFloat());
 }
 
 void Upscaler::ResizeBicubic(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
-  Resize(ImgPart, X, Y, w, h, &Upscaler::SampleBicubic);
+  Resize<BicubicKernel>(ImgPart, X, Y, w, h, UpscalerFloat());
 }
 
 void Upscaler::ResizeBilinear(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
-  Resize(ImgPart, X, Y, w, h, &Upscaler::SampleBilinear);
+  Resize<BilinearKernel>(ImgPart, X, Y, w, h, UpscalerFloat());
 }
 
 void Upscaler::ResizeNearest(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
-  Resize(ImgPart, X, Y, w, h, &Upscaler::SampleNearest);
+  Resize<NearestKernel>(ImgPart, X, Y, w, h, UpscalerFloat());
+}
+
+void Upscaler::ResizeBicubic(int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  Resize<BicubicKernel>(ImgPart, X, Y, w, h);
+}
+
+void Upscaler::ResizeBilinear(int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  Resize<BilinearKernel>(ImgPart, X, Y, w, h);
+}
+
+void Upscaler::ResizeNearest(int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  Resize<NearestKernel>(ImgPart, X, Y, w, h);
+}
+
+void Upscaler::ResizeBicubic(uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                             const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max) {
+  Resize<BicubicKernel>(ImgPart, X, Y, w, h, UpscalerPalette(Palette, PaletteSize, Min, Max));
+}
+
+void Upscaler::ResizeBilinear(uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                              const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max) {
+  Resize<BilinearKernel>(ImgPart, X, Y, w, h, UpscalerPalette(Palette, PaletteSize, Min, Max));
+}
+
+void Upscaler::ResizeNearest(uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                             const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max) {
+  Resize<NearestKernel>(ImgPart, X, Y, w, h, UpscalerPalette(Palette, PaletteSize, Min, Max));
+}
+
+void Upscaler::BeginStrips(UpscalerKernel Kernel) {
+  StripKernel = Kernel;
+  StripRow    = 0;
+  for(uint8_t i = 0; i < 4; i++)
+     RingRow[i] = -1;
+}
+
+uint16_t Upscaler::NextRows(float* ImgPart, uint16_t n) {
+  return Stream(ImgPart, n, UpscalerFloat());
+}
+
+uint16_t Upscaler::NextRows(uint16_t* ImgPart, uint16_t n,
+                            const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max) {
+  return Stream(ImgPart, n, UpscalerPalette(Palette, PaletteSize, Min, Max));
 }
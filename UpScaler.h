@@ -1,35 +1,123 @@
 #pragma once
 #include <cstdint>
+#include "UpScalerKernels.h"
+#include "UpScalerSIMD.h"
+#include "UpScalerPool.h"
 
+/*******************************************************************************
+ * Upscaler, resizes a float image with runtime geometry.
+ * For a geometry known at compile time, see FixedSize::Upscaler in
+ * UpScalerFixedSize.h, which shares the kernels and the resize engine.
+ ******************************************************************************/
 class Upscaler {
 private:
-  float*  InputImage;
   uint16_t InputWidth;
   uint16_t InputHeight;
-  uint16_t InputLastCol;
-  uint16_t InputLastRow;
+
+  /* copy of the input image with UpscalerPad samples border on each side,
+   * refreshed by each SetInputImage() call.
+   */
+  UpscalerBorder Border;
+  float*   PaddedInput;
+
+  /* see UpscalerSampling; ColPeriod != 0 selects the polyphase horizontal pass. */
+  UpscalerSampling Sampling;
+  uint8_t          ColPeriod;
 
   float*  OutputImage;
   uint16_t OutputWidth;
   uint16_t OutputHeight;
-  uint16_t OutputLastCol;
-  uint16_t OutputLastRow;
 
-  const float GetPixel(int x, int y);
-  float SampleBicubic (float x_fraction, float y_fraction);
-  float SampleBilinear(float x_fraction, float y_fraction);
-  float SampleNearest (float x_fraction, float y_fraction);
+  /* first input tap and weights for each output column and row, built on
+   * first use for the requested kernel and dropped whenever the geometry
+   * changes.
+   */
+  UpscalerKernel   TableKernel;
+  UpscalerTap<4>*  ColTaps;
+  UpscalerTap<4>*  RowTaps;
+
+  /* horizontally interpolated padded input rows, one of OutputWidth for each */
+  float*    HorzPass;
+
+  /* BeginStrips()/NextRows(): ring of the last four horizontally
+   * interpolated rows, RingRow[] holds their padded input row.
+   */
+  float*          Ring;
+  int16_t         RingRow[4];
+  uint16_t        StripRow;
+  UpscalerKernel  StripKernel;
+
+  /* vectorized horizontal pass, NULL: scalar. ColBlocks are built along
+   * with the tables while VectorRow is set, ColBlocksOk if they're usable.
+   */
+  UpscalerRowFn      VectorRow;
+  UpscalerTapBlock*  ColBlocks;
+  bool               ColBlocksOk;
+
+  /* parallel full image resize: one HorzPass per pool thread. */
+  UpscalerPool*   Pool;
+  float*          BandHorzPass;
+
+  /* fixed point path, allocated on first use. */
+  int16_t*           PaddedInputQ14;
+  UpscalerKernel     TableKernelQ14;
+  UpscalerTapQ14<4>* ColTapsQ14;
+  UpscalerTapQ14<4>* RowTapsQ14;
+  int32_t*           HorzPassQ14;
 
-  void Resize(float (Upscaler::*Sample)(float x_fraction, float y_fraction));
-  void Resize(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
-              float (Upscaler::*Sample)(float x_fraction, float y_fraction));
+  uint32_t PaddedSize(void);
+  void InputGeometryChanged(void);
+  void FreeTables(void);
+  template<class Kernel> bool PrepareTables(void);
+  UpscalerHorizontal Horizontal(void);
+  template<class Kernel, class T, class Store>
+  void Resize(T* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h, const Store& Output);
+  template<class Kernel> void ResizeBands(void);
+  template<class Kernel, class T, class Store>
+  uint16_t Stream(T* Dest, uint16_t n, const Store& Output);
+  template<class T, class Store>
+  uint16_t Stream(T* Dest, uint16_t n, const Store& Output);
+  template<class Kernel> void Resize(int16_t* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
 public:
-  Upscaler(void) {}
-  ~Upscaler(void) {}
+  Upscaler(void);
+  ~Upscaler(void);
+  Upscaler(const Upscaler&) = delete;
+  Upscaler& operator=(const Upscaler&) = delete;
+
+  /* copies Image into the internal padded input buffer, so call it again
+   * whenever the image data changed, ie. once per frame.
+   */
+  void SetInputImage(const float* Image, uint16_t Width, uint16_t Height);
+  /* input for the fixed point functions below, ie. in centi-degrees. */
+  void SetInputImage(const int16_t* Image, uint16_t Width, uint16_t Height);
+
+  /* how samples outside the input image are made up, default Replicate.
+   * Takes effect with the next SetInputImage() call.
+   */
+  void SetBorderMode(UpscalerBorder Mode);
 
-  void SetInputImage(float* Image, uint16_t Width, uint16_t Height);
   void SetOutputImage(float* Image, uint16_t Width, uint16_t Height);
 
+  /* default EdgeToEdge. With Aligned and an output width that is an exact
+   * multiple of the input width, ie. 32 -> 320, 640 or 1280, the float and
+   * RGB565 functions use the faster polyphase horizontal pass, unless a
+   * vectorized one is set, see SetISA().
+   */
+  void SetSampling(UpscalerSampling Mode);
+
+  /* instruction set of the horizontal pass, see UpScalerSIMD.h, for float
+   * and RGB565 output. Default UpscalerBestISA(), falls back to Scalar if
+   * 'isa' isn't supported.
+   */
+  void SetISA(UpscalerISA isa);
+
+  /* with a pool set, the full image functions below split the output into
+   * one row band per pool thread and resize the bands in parallel, using
+   * the strip functions' engine. NULL (default): single threaded.
+   * The pool must outlive its use here; the strip functions are unaffected.
+   */
+  void SetThreadPool(UpscalerPool* Pool);
+
   void ResizeBicubic (void);
   void ResizeBilinear(void);
   void ResizeNearest (void);
@@ -43,4 +131,36 @@ public:
   void ResizeBicubic (float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
   void ResizeBilinear(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
   void ResizeNearest (float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
+
+  /* the same in fixed point arithmetics, for targets with a slow FPU:
+   * int16 input samples (see SetInputImage()) and Q1.14 weights, results
+   * are in the unit of the input samples. Integer only and bit identical
+   * on every target; differs from the float functions by rounding only.
+   */
+  void ResizeBicubic (int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
+  void ResizeBilinear(int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
+  void ResizeNearest (int16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h);
+
+  /* upscale and color map in one pass: Min..Max maps linearly onto the
+   * PaletteSize entries of Palette, values outside onto its first or last
+   * entry. ImgPart receives (w x h) display ready colors, ie. RGB565.
+   */
+  void ResizeBicubic (uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                      const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max);
+  void ResizeBilinear(uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                      const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max);
+  void ResizeNearest (uint16_t* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                      const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max);
+
+  /* streaming alternative to the strip functions: after BeginStrips(), each
+   * NextRows() call writes the next n full width output rows to ImgPart and
+   * returns the number of rows written, 0 after the last row.
+   * Each input row is interpolated horizontally only once per frame, and
+   * instead of InputHeight+4 rows only four are buffered.
+   * Call SetInputImage() before BeginStrips(), not while streaming.
+   */
+  void BeginStrips(UpscalerKernel Kernel = UpscalerKernel::Bicubic);
+  uint16_t NextRows(float* ImgPart, uint16_t n);
+  uint16_t NextRows(uint16_t* ImgPart, uint16_t n,
+                    const uint16_t* Palette, uint16_t PaletteSize, float Min, float Max);
 };
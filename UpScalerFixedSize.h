@@ -0,0 +1,78 @@
+#pragma once
+#include "UpScalerKernels.h"
+
+#if __cplusplus < 201402L
+   #error "FixedSize::Upscaler needs C++14 to build its tap tables at compile time."
+#endif
+
+/*******************************************************************************
+ * FixedSize::Upscaler, the compile time counterpart of class Upscaler.
+ *
+ * Geometry and kernel are template parameters, the tap tables are generated
+ * at compile time and the whole resize inlines into the caller, ie.
+ *    FixedSize::Upscaler<32, 24, 300, 220, BicubicKernel> Scaler;
+ *    Scaler.SetInputImage(temps);
+ *    Scaler.Resize(part, 0, y, 300, 20);
+ * gives the same output as Upscaler::ResizeBicubic() for that geometry.
+ ******************************************************************************/
+namespace FixedSize {
+
+template<uint16_t InW, uint16_t InH, uint16_t OutW, uint16_t OutH, class Kernel>
+class Upscaler {
+private:
+  template<uint16_t OutSize, uint16_t InSize>
+  struct TapTable {
+     UpscalerTap<Kernel::Taps> Tap[OutSize];
+
+     constexpr TapTable() : Tap() {
+        for(uint16_t o = 0; o < OutSize; o++)
+           BuildTap<Kernel>(Tap[o], o, OutSize, InSize);
+        }
+  };
+
+  static constexpr TapTable<OutW, InW> Cols{};
+  static constexpr TapTable<OutH, InH> Rows{};
+
+  static constexpr uint16_t Stride = InW + 2 * UpscalerPad;
+
+  UpscalerBorder Border = UpscalerBorder::Replicate;
+  float PaddedInput[(InH + 2 * UpscalerPad) * Stride];
+  float HorzPass[(InH + 2 * UpscalerPad) * OutW];
+public:
+  static constexpr uint16_t InputWidth   = InW;
+  static constexpr uint16_t InputHeight  = InH;
+  static constexpr uint16_t OutputWidth  = OutW;
+  static constexpr uint16_t OutputHeight = OutH;
+
+  /* see Upscaler::SetBorderMode() */
+  void SetBorderMode(UpscalerBorder Mode) {
+     Border = Mode;
+     }
+
+  /* copies Image (InW x InH float's), call again whenever the image data changed. */
+  void SetInputImage(const float* Image) {
+     PadImage(Image, InW, InH, PaddedInput, Border);
+     }
+
+  /* Output is OutW x OutH float's. */
+  void Resize(float* Output) {
+     SeparableResize<Kernel>(PaddedInput, Stride, Cols.Tap, Rows.Tap, UpscalerHorizontal(), HorzPass, OutW,
+                             Output, 0, 0, OutW, OutH);
+     }
+
+  /* subpart X,Y,w,h of the output image, ImgPart holds at least (w x h) float's. */
+  void Resize(float* ImgPart, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+     SeparableResize<Kernel>(PaddedInput, Stride, Cols.Tap, Rows.Tap, UpscalerHorizontal(), HorzPass, OutW,
+                             ImgPart, X, Y, w, h);
+     }
+};
+
+template<uint16_t InW, uint16_t InH, uint16_t OutW, uint16_t OutH, class Kernel>
+constexpr typename Upscaler<InW, InH, OutW, OutH, Kernel>::template TapTable<OutW, InW>
+   Upscaler<InW, InH, OutW, OutH, Kernel>::Cols;
+
+template<uint16_t InW, uint16_t InH, uint16_t OutW, uint16_t OutH, class Kernel>
+constexpr typename Upscaler<InW, InH, OutW, OutH, Kernel>::template TapTable<OutH, InH>
+   Upscaler<InW, InH, OutW, OutH, Kernel>::Rows;
+
+} // namespace FixedSize
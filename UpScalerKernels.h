@@ -0,0 +1,516 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*******************************************************************************
+ * Interpolation kernels and the separable resize engine shared by the runtime
+ * class Upscaler and the compile time specialized FixedSize::Upscaler.
+ *
+ * A kernel reads 'Taps' consecutive input samples, starting 'First' samples
+ * left of (or above) the integer part of the sampling position, and weights
+ * them by the fractional part t of the sampling position.
+ ******************************************************************************/
+
+// C++11 doesn't allow loops in constexpr functions; tables are then built at runtime only.
+#if __cplusplus >= 201402L
+   #define UPSCALER_CONSTEXPR constexpr
+#else
+   #define UPSCALER_CONSTEXPR inline
+#endif
+
+/* rounding a/b to nearest for b > 0, ties away from zero. */
+inline int64_t UpscalerRoundDiv(int64_t a, int64_t b) {
+  return a >= 0 ? (a + b/2) / b : -((-a + b/2) / b);
+}
+
+enum class UpscalerKernel : uint8_t { None, Nearest, Bilinear, Bicubic };
+
+struct NearestKernel {
+  static constexpr UpscalerKernel Id = UpscalerKernel::Nearest;
+  static constexpr uint8_t Taps  = 1;
+  static constexpr int8_t  First = 0;
+
+  static UPSCALER_CONSTEXPR void Weights(float t, float* w) {
+     (void) t;
+     w[0] = 1.0f;
+     }
+
+  static void WeightsQ14(uint32_t f, uint32_t D, int16_t* w) {
+     (void) f; (void) D;
+     w[0] = 16384;
+     }
+};
+
+struct BilinearKernel {
+  static constexpr UpscalerKernel Id = UpscalerKernel::Bilinear;
+  static constexpr uint8_t Taps  = 2;
+  static constexpr int8_t  First = 0;
+
+  static UPSCALER_CONSTEXPR void Weights(float t, float* w) {
+     w[0] = 1.0f - t;
+     w[1] = t;
+     }
+
+  static void WeightsQ14(uint32_t f, uint32_t D, int16_t* w) {
+     w[1] = UpscalerRoundDiv(16384LL * f, D);
+     w[0] = 16384 - w[1];
+     }
+};
+
+struct BicubicKernel {
+  static constexpr UpscalerKernel Id = UpscalerKernel::Bicubic;
+  static constexpr uint8_t Taps  = 4;
+  static constexpr int8_t  First = -1;
+
+  /* CubicHermite(A,B,C,D,t) = a*t^3 + b*t^2 + c*t + d, with
+   *   a = -0.5*(A - 3B + 3C - D), b = A - 2.5B + 2C - 0.5D, c = -0.5A + 0.5C, d = B
+   * regrouped as weights of the four samples A..D.
+   */
+  static UPSCALER_CONSTEXPR void Weights(float t, float* w) {
+     float t2 = t * t;
+     float t3 = t2 * t;
+
+     w[0] = -0.5f * t3 +         t2 - 0.5f * t;
+     w[1] =  1.5f * t3 - 2.5f  * t2 + 1.0f;
+     w[2] = -1.5f * t3 + 2.0f  * t2 + 0.5f * t;
+     w[3] =  0.5f * t3 - 0.5f  * t2;
+     }
+
+  /* the same weights for t = f/D in Q1.14, computed exactly in integers and
+   * corrected to sum up to 1.0, so that they are bit identical on all targets.
+   */
+  static void WeightsQ14(uint32_t f, uint32_t D, int16_t* w) {
+     int64_t f1 = f, f2 = f1 * f1, f3 = f2 * f1;
+     int64_t D1 = D, D2 = D1 * D1, D3 = D2 * D1;
+
+     w[0] = UpscalerRoundDiv(8192 * (    -f3 + 2 * f2 * D1 -     f1 * D2         ), D3);
+     w[1] = UpscalerRoundDiv(8192 * ( 3 * f3 - 5 * f2 * D1                + 2 * D3), D3);
+     w[2] = UpscalerRoundDiv(8192 * (-3 * f3 + 4 * f2 * D1 +     f1 * D2         ), D3);
+     w[3] = UpscalerRoundDiv(8192 * (     f3 -     f2 * D1                       ), D3);
+
+     int16_t Residual = 16384 - (w[0] + w[1] + w[2] + w[3]);
+     w[w[1] >= w[2] ? 1 : 2] += Residual;
+     }
+};
+
+/* the resize engine reads a copy of the input image with UpscalerPad extra
+ * samples on each side, so that no tap needs to be clamped to the image.
+ * 2 is enough for all kernels above, ie. 36x28 for the 32x24 sensor.
+ */
+constexpr uint8_t UpscalerPad = 2;
+
+/* how the border of the padded copy is filled:
+ * Replicate: repeat the outermost sample, ie. ..aa|abcd|dd..
+ * Mirror:    reflect at the image edge,   ie. ..ba|abcd|dc..
+ */
+enum class UpscalerBorder : uint8_t { Replicate, Mirror };
+
+template<class T>
+inline void PadImage(const T* In, uint16_t Width, uint16_t Height, T* Out, UpscalerBorder Border) {
+  const uint16_t Stride = Width + 2 * UpscalerPad;
+  const int      Rows   = Height + 2 * UpscalerPad;
+
+  for(int r = 0; r < Rows; r++) {
+     int y = r - UpscalerPad;
+     if (y < 0)
+        y = Border == UpscalerBorder::Mirror ? -1 - y : 0;
+     else if (y >= Height)
+        y = Border == UpscalerBorder::Mirror ? 2 * Height - 1 - y : Height - 1;
+
+     const T* Src = In + y * Width;
+     T* Dst = Out + r * Stride;
+
+     for(int i = 0; i < UpscalerPad; i++) {
+        Dst[UpscalerPad - 1 - i]          = Src[Border == UpscalerBorder::Mirror ? i : 0];
+        Dst[UpscalerPad + Width + i]      = Src[Border == UpscalerBorder::Mirror ? Width - 1 - i : Width - 1];
+        }
+     for(uint16_t x = 0; x < Width; x++)
+        Dst[UpscalerPad + x] = Src[x];
+     }
+}
+
+/* first input sample of one output column or row in the padded input and
+ * the weights of this and the following Kernel::Taps - 1 samples.
+ */
+template<uint8_t N>
+struct UpscalerTap {
+  uint16_t Index;
+  float    Weight[N];
+};
+
+/* the same in fixed point: Q1.14 weights for int16 samples. */
+template<uint8_t N>
+struct UpscalerTapQ14 {
+  uint16_t Index;
+  int16_t  Weight[N];
+};
+
+/* how output positions map onto the input:
+ * EdgeToEdge: the first output sample hits input 0, the last one input
+ *             InSize, ie. pos = o * InSize / (OutSize - 1).
+ * Aligned:    output o hits input o * InSize / OutSize, ie. o / S for an
+ *             exact scale factor S. Then the weights repeat every S outputs,
+ *             which allows the polyphase horizontal pass below.
+ */
+enum class UpscalerSampling : uint8_t { EdgeToEdge, Aligned };
+
+/* first tap and weights of output position o of OutSize on InSize inputs.
+ * EdgeToEdge samples input InSize as input InSize - 1 with t = 1.0, which
+ * keeps all taps inside the padding. Aligned splits pos exactly in integers,
+ * so that all outputs of the same phase get identical weights.
+ */
+template<class Kernel, uint8_t N>
+UPSCALER_CONSTEXPR void BuildTap(UpscalerTap<N>& Tap, uint16_t o, uint16_t OutSize, uint16_t InSize,
+                                 UpscalerSampling Sampling = UpscalerSampling::EdgeToEdge) {
+  int n = 0;
+  float t = 0.0f;
+
+  if (Sampling == UpscalerSampling::Aligned) {
+     uint32_t pos = uint32_t(o) * InSize;
+     n = pos / OutSize;
+     t = float(pos % OutSize) / float(OutSize);
+     }
+  else {
+     uint16_t OutLast = OutSize - 1;
+     float pos = (OutLast ? o / float(OutLast) : 0.0f) * InSize;
+     n = int(pos); // pos >= 0: truncation == floor
+     t = pos - float(n);
+
+     if (n >= InSize) {
+        n = InSize - 1;
+        t = 1.0f;
+        }
+     }
+
+  Kernel::Weights(t, Tap.Weight);
+  Tap.Index = n + Kernel::First + UpscalerPad;
+}
+
+/* BuildTap() in exact integer arithmetic, pos = o * InSize / D with
+ * D = OutSize - 1 (EdgeToEdge) or OutSize (Aligned).
+ */
+template<class Kernel, uint8_t N>
+inline void BuildTapQ14(UpscalerTapQ14<N>& Tap, uint16_t o, uint16_t OutSize, uint16_t InSize,
+                        UpscalerSampling Sampling = UpscalerSampling::EdgeToEdge) {
+  uint32_t D = Sampling == UpscalerSampling::Aligned ? OutSize : OutSize - 1;
+  if (!D) {
+     D = 1;
+     o = 0;
+     }
+  uint32_t pos = o * uint32_t(InSize);
+  int n = pos / D;
+  uint32_t f = pos % D;
+
+  if (n >= InSize) {
+     n = InSize - 1;
+     f = D;
+     }
+
+  Kernel::WeightsQ14(f, D, Tap.Weight);
+  Tap.Index = n + Kernel::First + UpscalerPad;
+}
+
+/* the scale factor S if the column taps of OutSize on InSize repeat every
+ * S outputs, else 0.
+ */
+inline uint8_t UpscalerPeriod(uint16_t OutSize, uint16_t InSize, UpscalerSampling Sampling) {
+  if (Sampling != UpscalerSampling::Aligned || !InSize || OutSize % InSize)
+     return 0;
+  uint16_t S = OutSize / InSize;
+  return S <= 255 ? S : 0;
+}
+
+/* column taps of the vectorized horizontal pass, for each block of 8 output
+ * columns: all their taps lie within the 8 input samples from Base on, each
+ * column's first tap is at Base + Offset[i], its weights in Weight[k][i].
+ */
+struct UpscalerTapBlock {
+  int32_t Base;
+  int32_t Offset[8];
+  float   Weight[4][8];
+};
+
+/* the blocks of the first OutSize / 8 * 8 columns of Cols, for input rows
+ * of InStride samples. False if a block's taps span more than 8 samples,
+ * ie. when downscaling; the vectorized pass can't be used then.
+ */
+template<class Kernel, uint8_t N>
+inline bool BuildTapBlocks(const UpscalerTap<N>* Cols, uint16_t OutSize, uint16_t InStride,
+                           UpscalerTapBlock* Blocks) {
+  if (InStride < 8)
+     return false;
+
+  for(uint16_t b = 0; b < OutSize / 8; b++) {
+     const UpscalerTap<N>* Tap = Cols + 8 * b;
+     UpscalerTapBlock& Block = Blocks[b];
+
+     // last block of a row: keep the 8 samples inside the row
+     Block.Base = Tap[0].Index + 8 <= InStride ? Tap[0].Index : InStride - 8;
+     for(uint8_t i = 0; i < 8; i++) {
+        Block.Offset[i] = Tap[i].Index - Block.Base;
+        if (Block.Offset[i] < 0 || Block.Offset[i] + Kernel::Taps > 8)
+           return false;
+        for(uint8_t k = 0; k < 4; k++)
+           Block.Weight[k][i] = k < Kernel::Taps ? Tap[i].Weight[k] : 0.0f;
+        }
+     }
+  return true;
+}
+
+/* a vectorized horizontal pass, see UpScalerSIMD.h: HorizontalRow() for
+ * the columns X..xmax-1, both multiples of 8, from Blocks[X / 8] on.
+ */
+typedef void (*UpscalerRowFn)(const float* Src, const UpscalerTapBlock* Blocks, uint8_t Taps,
+                              float* Out, uint16_t X, uint16_t xmax);
+
+/* how HorizontalPass() interpolates a row: with Row on Blocks if set, else
+ * polyphase with a Period != 0, else by HorizontalRow().
+ */
+struct UpscalerHorizontal {
+  uint8_t                 Period;
+  UpscalerRowFn           Row;
+  const UpscalerTapBlock* Blocks;
+
+  UpscalerHorizontal(uint8_t Period = 0, UpscalerRowFn Row = NULL, const UpscalerTapBlock* Blocks = NULL) :
+     Period(Period), Row(Row), Blocks(Blocks) {}
+};
+
+/* output stages of SeparableResize(), converting each interpolated sample
+ * into the type stored in Dest.
+ */
+struct UpscalerFloat {
+  float operator()(float v) const {
+     return v;
+     }
+};
+
+/* maps Min..Max linearly onto the entries of a color palette,
+ * ie. temperatures onto RGB565 colors for the display.
+ */
+struct UpscalerPalette {
+  const uint16_t* Colors;
+  float Last;  // index of the last color
+  float Min;
+  float Slope;
+
+  UpscalerPalette(const uint16_t* Palette, uint16_t Size, float Min, float Max) :
+     Colors(Palette), Last(Size - 1), Min(Min), Slope((Size - 1) / (Max - Min)) {}
+
+  uint16_t operator()(float v) const {
+     float i = (v - Min) * Slope;
+     if (!(i > 0.0f)) // also catches NaN
+        return Colors[0];
+     if (i > Last)
+        i = Last;
+     return Colors[int(i)];
+     }
+};
+
+/* horizontal pass: interpolates output columns X..xmax-1 of one padded input row. */
+template<class Kernel, uint8_t N>
+inline void HorizontalRow(const float* Src, const UpscalerTap<N>* Cols, float* Out,
+                          uint16_t X, uint16_t xmax) {
+  for(uint16_t x = X; x < xmax; x++) {
+     const UpscalerTap<N>& Tap = Cols[x];
+     const float* s = Src + Tap.Index;
+     float v = Tap.Weight[0] * s[0];
+     for(uint8_t k = 1; k < Kernel::Taps; k++)
+        v += Tap.Weight[k] * s[k];
+     Out[x] = v;
+     }
+}
+
+/* polyphase horizontal pass for Cols with period S (see UpscalerPeriod()):
+ * Cols[0..S-1] hold the S phase weights, all phases of input sample n read
+ * the same taps. So each input sample's taps are loaded once and S outputs
+ * computed from them, without any table lookup per output. Same sums in the
+ * same order as HorizontalRow(), ie. bit identical results.
+ */
+template<class Kernel, uint8_t N>
+inline void HorizontalRowPolyphase(const float* Src, const UpscalerTap<N>* Cols, uint8_t S, float* Out,
+                                   uint16_t X, uint16_t xmax) {
+  const float* s = Src + Cols[0].Index + X / S;
+  uint8_t p = X % S;
+
+  for(uint16_t x = X; x < xmax; s++, p = 0) {
+     float a[Kernel::Taps];
+     for(uint8_t k = 0; k < Kernel::Taps; k++)
+        a[k] = s[k];
+
+     for(; p < S && x < xmax; p++, x++) {
+        const float* w = Cols[p].Weight;
+        float v = w[0] * a[0];
+        for(uint8_t k = 1; k < Kernel::Taps; k++)
+           v += w[k] * a[k];
+        Out[x] = v;
+        }
+     }
+}
+
+/* one row as selected by Horizontal, see UpscalerHorizontal. The vectorized
+ * Row takes the whole blocks, HorizontalRow() the columns left and right.
+ */
+template<class Kernel, uint8_t N>
+inline void HorizontalPass(const float* Src, const UpscalerTap<N>* Cols, const UpscalerHorizontal& Horizontal,
+                           float* Out, uint16_t X, uint16_t xmax) {
+  uint16_t Begin = (X + 7) & ~7;
+  uint16_t End   = xmax & ~7;
+
+  if (Horizontal.Row && Begin < End) {
+     HorizontalRow<Kernel>(Src, Cols, Out, X, Begin);
+     Horizontal.Row(Src, Horizontal.Blocks, Kernel::Taps, Out, Begin, End);
+     HorizontalRow<Kernel>(Src, Cols, Out, End, xmax);
+     }
+  else if (Horizontal.Period)
+     HorizontalRowPolyphase<Kernel>(Src, Cols, Horizontal.Period, Out, X, xmax);
+  else
+     HorizontalRow<Kernel>(Src, Cols, Out, X, xmax);
+}
+
+/* vertical pass: one output row from the Kernel::Taps horizontally
+ * interpolated rows Src[], columns X..xmax-1 stored from Dest on.
+ */
+template<class Kernel, uint8_t N, class T, class Store>
+inline void VerticalRow(const float* const* Src, const UpscalerTap<N>& Tap, T* Dest,
+                        uint16_t X, uint16_t xmax, const Store& Output) {
+  for(uint16_t x = X; x < xmax; x++) {
+     float v = Tap.Weight[0] * Src[0][x];
+     for(uint8_t k = 1; k < Kernel::Taps; k++)
+        v += Tap.Weight[k] * Src[k][x];
+     *Dest++ = Output(v);
+     }
+}
+
+/* separable resize of the output rectangle X,Y,w,h into Dest (w x h):
+ * first interpolate the rows of the padded input In (InStride samples per
+ * row) covered by the output rows horizontally into HorzPass (one row of
+ * OutWidth for each padded input row), then interpolate each output row
+ * vertically from Kernel::Taps of these rows.
+ * Horizontal: see HorizontalPass().
+ */
+template<class Kernel, uint8_t N, class T, class Store = UpscalerFloat>
+inline void SeparableResize(const float* In, uint16_t InStride,
+                            const UpscalerTap<N>* Cols, const UpscalerTap<N>* Rows,
+                            const UpscalerHorizontal& Horizontal,
+                            float* HorzPass, uint16_t OutWidth,
+                            T* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+                            const Store& Output = Store()) {
+  if (!w || !h)
+     return;
+
+  uint16_t xmax = X+w;
+  uint16_t ymax = Y+h;
+
+  // taps are monotonic: first tap of the first row to last tap of the last row.
+  uint16_t FirstRow = Rows[Y].Index;
+  uint16_t LastRow  = Rows[ymax - 1].Index + Kernel::Taps - 1;
+
+  for(uint16_t r = FirstRow; r <= LastRow; r++)
+     HorizontalPass<Kernel>(In + r * InStride, Cols, Horizontal, HorzPass + r * OutWidth, X, xmax);
+
+  T* CurrentRow = Dest;
+
+  for(uint16_t y = Y; y < ymax; y++) {
+     const UpscalerTap<N>& Tap = Rows[y];
+     const float* Src[N];
+     for(uint8_t k = 0; k < Kernel::Taps; k++)
+        Src[k] = HorzPass + (Tap.Index + k) * OutWidth;
+
+     VerticalRow<Kernel>(Src, Tap, CurrentRow, X, xmax, Output);
+     CurrentRow += w;
+     }
+}
+
+/* streaming resize: full width output rows are produced top to bottom. The
+ * horizontally interpolated padded input rows are kept in a ring of N rows
+ * (slot = row % N), and a row is only interpolated when the vertical taps
+ * advance onto it, ie. each input row once per frame.
+ * RingRow[] holds the padded input row of each slot, -1 if empty.
+ */
+template<class Kernel, uint8_t N, class T, class Store = UpscalerFloat>
+inline uint16_t StreamRows(const float* In, uint16_t InStride,
+                           const UpscalerTap<N>* Cols, const UpscalerTap<N>* Rows,
+                           const UpscalerHorizontal& Horizontal,
+                           float* Ring, int16_t* RingRow, uint16_t OutWidth, uint16_t OutHeight,
+                           uint16_t& NextRow, T* Dest, uint16_t n,
+                           const Store& Output = Store()) {
+  uint16_t Count = 0;
+
+  for(; Count < n && NextRow < OutHeight; Count++, NextRow++) {
+     const UpscalerTap<N>& Tap = Rows[NextRow];
+     const float* Src[N];
+
+     for(uint8_t k = 0; k < Kernel::Taps; k++) {
+        int16_t r    = Tap.Index + k;
+        uint8_t Slot = r % N;
+        float*  Row  = Ring + Slot * OutWidth;
+
+        if (RingRow[Slot] != r) {
+           HorizontalPass<Kernel>(In + r * InStride, Cols, Horizontal, Row, 0, OutWidth);
+           RingRow[Slot] = r;
+           }
+        Src[k] = Row;
+        }
+
+     VerticalRow<Kernel>(Src, Tap, Dest, 0, OutWidth, Output);
+     Dest += OutWidth;
+     }
+
+  return Count;
+}
+
+/* SeparableResize() for int16 samples (ie. centi-degrees) and Q1.14 weights.
+ * Sums are 32bit, both passes round to nearest; the horizontal pass keeps its
+ * results in 32bit, only the final result saturates to int16. Pure integer
+ * arithmetic, so the result is bit identical on host and micro controller.
+ * (relies on >> being an arithmetic shift for negative values, as gcc does.)
+ */
+template<class Kernel, uint8_t N>
+inline void SeparableResizeQ14(const int16_t* In, uint16_t InStride,
+                               const UpscalerTapQ14<N>* Cols, const UpscalerTapQ14<N>* Rows,
+                               int32_t* HorzPass, uint16_t OutWidth,
+                               int16_t* Dest, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  if (!w || !h)
+     return;
+
+  uint16_t xmax = X+w;
+  uint16_t ymax = Y+h;
+
+  uint16_t FirstRow = Rows[Y].Index;
+  uint16_t LastRow  = Rows[ymax - 1].Index + Kernel::Taps - 1;
+
+  for(uint16_t r = FirstRow; r <= LastRow; r++) {
+     const int16_t* Src = In       + r * InStride;
+     int32_t*       Out = HorzPass + r * OutWidth;
+
+     for(uint16_t x = X; x < xmax; x++) {
+        const UpscalerTapQ14<N>& Tap = Cols[x];
+        const int16_t* s = Src + Tap.Index;
+        int32_t v = 8192;
+        for(uint8_t k = 0; k < Kernel::Taps; k++)
+           v += int32_t(Tap.Weight[k]) * s[k];
+        Out[x] = v >> 14;
+        }
+     }
+
+  int16_t* CurrentRow = Dest;
+
+  for(uint16_t y = Y; y < ymax; y++) {
+     const UpscalerTapQ14<N>& Tap = Rows[y];
+     const int32_t* Src[N];
+     for(uint8_t k = 0; k < Kernel::Taps; k++)
+        Src[k] = HorzPass + (Tap.Index + k) * OutWidth;
+
+     int16_t* NextPixel = CurrentRow;
+
+     for(uint16_t x = X; x < xmax; x++) {
+        int32_t v = 8192;
+        for(uint8_t k = 0; k < Kernel::Taps; k++)
+           v += Tap.Weight[k] * Src[k][x];
+        v >>= 14;
+        *NextPixel++ = v < -32768 ? -32768 : v > 32767 ? 32767 : v;
+        }
+
+     CurrentRow += w;
+     }
+}
@@ -0,0 +1,86 @@
+#include "UpScalerPool.h"
+#include <cstddef>
+
+#ifdef UPSCALER_THREADS
+
+UpscalerPool::UpscalerPool(uint8_t Threads) :
+  Count(Threads), Current(NULL), Jobs(0), NextJob(0), Pending(0), Generation(0), Quit(false) {
+  if (!Count) {
+     unsigned Cores = std::thread::hardware_concurrency();
+     Count = Cores ? (Cores < 255 ? Cores : 255) : 1;
+     }
+
+  for(uint8_t t = 1; t < Count; t++)
+     Workers.emplace_back(&UpscalerPool::Worker, this, t);
+}
+
+UpscalerPool::~UpscalerPool(void) {
+  {
+  std::lock_guard<std::mutex> Locked(Lock);
+  Quit = true;
+  }
+  Wake.notify_all();
+  for(std::thread& t : Workers)
+     t.join();
+}
+
+/* takes jobs until none is left, Lock held on entry and exit. */
+void UpscalerPool::Work(uint8_t Thread, std::unique_lock<std::mutex>& Locked) {
+  while(NextJob < Jobs) {
+     uint16_t j = NextJob++;
+     const Job& Fn = *Current;
+     Locked.unlock();
+     Fn(j, Thread);
+     Locked.lock();
+     if (--Pending == 0)
+        Done.notify_all();
+     }
+}
+
+void UpscalerPool::Worker(uint8_t Thread) {
+  uint32_t Seen = 0;
+  std::unique_lock<std::mutex> Locked(Lock);
+  for(;;) {
+     Wake.wait(Locked, [&] { return Quit || Generation != Seen; });
+     if (Quit)
+        return;
+     Seen = Generation;
+     Work(Thread, Locked);
+     }
+}
+
+void UpscalerPool::Run(uint16_t n, const Job& Fn) {
+  if (!n)
+     return;
+
+  if (Workers.empty()) {
+     for(uint16_t j = 0; j < n; j++)
+        Fn(j, 0);
+     return;
+     }
+
+  std::unique_lock<std::mutex> Locked(Lock);
+  Current = &Fn;
+  Jobs    = n;
+  NextJob = 0;
+  Pending = n;
+  Generation++;
+  Wake.notify_all();
+
+  Work(0, Locked);
+  Done.wait(Locked, [&] { return Pending == 0; });
+  Current = NULL;
+}
+
+#else
+
+UpscalerPool::UpscalerPool(uint8_t) : Count(1) {}
+
+UpscalerPool::~UpscalerPool(void) {}
+
+void UpscalerPool::Run(uint16_t n, const Job& Fn) {
+  for(uint16_t j = 0; j < n; j++)
+     Fn(j, 0);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+#if !defined(ARDUINO)
+   #define UPSCALER_THREADS
+   #include <condition_variable>
+   #include <mutex>
+   #include <thread>
+   #include <vector>
+#endif
+
+/*******************************************************************************
+ * UpscalerPool, a fixed pool of worker threads for host builds. Run() hands
+ * out the jobs 0..Jobs-1 to the workers and the calling thread, and returns
+ * once all of them are done.
+ * Without thread support (ie. the sketch), the calling thread runs all jobs.
+ ******************************************************************************/
+class UpscalerPool {
+public:
+  typedef std::function<void(uint16_t Job, uint8_t Thread)> Job;
+
+  /* 'Threads' includes the calling thread, 0: one per cpu core. */
+  explicit UpscalerPool(uint8_t Threads = 0);
+  ~UpscalerPool(void);
+  UpscalerPool(const UpscalerPool&) = delete;
+  UpscalerPool& operator=(const UpscalerPool&) = delete;
+
+  uint8_t Threads(void) const { return Count; }
+
+  /* Fn(Job, Thread) for each Job < Jobs, Thread < Threads() identifies the
+   * running thread, ie. for per thread buffers.
+   */
+  void Run(uint16_t Jobs, const Job& Fn);
+
+private:
+  uint8_t Count;
+#ifdef UPSCALER_THREADS
+  std::vector<std::thread> Workers;
+  std::mutex               Lock;
+  std::condition_variable  Wake;
+  std::condition_variable  Done;
+  const Job*               Current;
+  uint16_t                 Jobs;
+  uint16_t                 NextJob;
+  uint16_t                 Pending;
+  uint32_t                 Generation;
+  bool                     Quit;
+
+  void Worker(uint8_t Thread);
+  void Work(uint8_t Thread, std::unique_lock<std::mutex>& Locked);
+#endif
+};
@@ -0,0 +1,97 @@
+#include "UpScalerSIMD.h"
+#include <cstddef>
+#pragma GCC optimize ("O3")
+
+#if defined(__x86_64__) || defined(__i386__)
+   #define UPSCALER_X86
+   #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+   #define UPSCALER_NEON
+#endif
+
+namespace {
+
+#ifdef UPSCALER_X86
+/* 8 output columns per iteration: the 8 input samples of the block, permuted
+ * into place for each tap.
+ */
+template<uint8_t Taps>
+__attribute__((target("avx2")))
+void RowAVX2(const float* Src, const UpscalerTapBlock* Blocks, float* Out, uint16_t X, uint16_t xmax) {
+  const __m256i One = _mm256_set1_epi32(1);
+
+  for(uint32_t x = X; x < xmax; x += 8) {
+     const UpscalerTapBlock& Block = Blocks[x / 8];
+     __m256  s = _mm256_loadu_ps(Src + Block.Base);
+     __m256i i = _mm256_loadu_si256((const __m256i*) Block.Offset);
+     __m256  v = _mm256_mul_ps(_mm256_loadu_ps(Block.Weight[0]), _mm256_permutevar8x32_ps(s, i));
+     for(uint8_t k = 1; k < Taps; k++) {
+        i = _mm256_add_epi32(i, One);
+        v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu_ps(Block.Weight[k]),
+                                           _mm256_permutevar8x32_ps(s, i)));
+        }
+     _mm256_storeu_ps(Out + x, v);
+     }
+}
+
+void HorizontalAVX2(const float* Src, const UpscalerTapBlock* Blocks, uint8_t Taps,
+                    float* Out, uint16_t X, uint16_t xmax) {
+  switch(Taps) {
+     case 1:  RowAVX2<1>(Src, Blocks, Out, X, xmax); break;
+     case 2:  RowAVX2<2>(Src, Blocks, Out, X, xmax); break;
+     default: RowAVX2<4>(Src, Blocks, Out, X, xmax);
+     }
+}
+#endif
+
+} // namespace
+
+bool UpscalerHasISA(UpscalerISA isa) {
+  switch(isa) {
+     case UpscalerISA::Scalar:
+        return true;
+#ifdef UPSCALER_X86
+     case UpscalerISA::SSE41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+     case UpscalerISA::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef UPSCALER_NEON
+     case UpscalerISA::NEON:
+        return true;
+#endif
+     default:
+        return false;
+     }
+}
+
+UpscalerISA UpscalerBestISA(void) {
+  static const UpscalerISA Best =
+     UpscalerHasISA(UpscalerISA::AVX2)  ? UpscalerISA::AVX2  :
+     UpscalerHasISA(UpscalerISA::NEON)  ? UpscalerISA::NEON  :
+     UpscalerHasISA(UpscalerISA::SSE41) ? UpscalerISA::SSE41 : UpscalerISA::Scalar;
+  return Best;
+}
+
+const char* UpscalerISAName(UpscalerISA isa) {
+  switch(isa) {
+     case UpscalerISA::SSE41: return "sse4.1";
+     case UpscalerISA::AVX2:  return "avx2";
+     case UpscalerISA::NEON:  return "neon";
+     default:                 return "scalar";
+     }
+}
+
+UpscalerRowFn UpscalerHorizontalRow(UpscalerISA isa) {
+  if (!UpscalerHasISA(isa))
+     return NULL;
+
+  switch(isa) {
+#ifdef UPSCALER_X86
+     case UpscalerISA::AVX2:  return HorizontalAVX2;
+#endif
+     default:                 return NULL;
+     }
+}
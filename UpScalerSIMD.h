@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include "UpScalerKernels.h"
+
+/*******************************************************************************
+ * vectorized horizontal pass of the resize engine, for host builds exporting
+ * large images. Each output column gathers its own Taps input samples with
+ * its own weights, which compilers don't vectorize; the vertical pass they
+ * do (and it's bound by the stores of the output then anyway).
+ * Upscaling, the taps of 8 neighboring columns fit into 8 input samples, so
+ * one load and a permute per tap serve 8 columns, see UpscalerTapBlock.
+ * The scalar engine stays the reference and the fallback; on targets without
+ * AVX2, ie. the ESP32, the others run Scalar.
+ * The AVX2 pass sums in the same order as the scalar code and doesn't use
+ * fused multiply-add, ie. its results are bit identical to it.
+ ******************************************************************************/
+enum class UpscalerISA : uint8_t { Scalar, SSE41, AVX2, NEON };
+
+/* true, if this build and the cpu we're running on support 'isa'. */
+bool UpscalerHasISA(UpscalerISA isa);
+
+/* the widest supported one, detected once at runtime. */
+UpscalerISA UpscalerBestISA(void);
+
+const char* UpscalerISAName(UpscalerISA isa);
+
+/* horizontal row function for 'isa', NULL if it runs Scalar. */
+UpscalerRowFn UpscalerHorizontalRow(UpscalerISA isa);
@@ -0,0 +1,529 @@
+/*******************************************************************************
+ * UpscalerBench, host benchmark and self check of the resize engine.
+ *
+ * build (from this folder):
+ *   g++ -O2 -std=c++14 -pthread -I.. UpscalerBench.cpp ../UpScaler.cpp ../UpScalerSIMD.cpp \
+ *       ../UpScalerPool.cpp -o UpscalerBench
+ *
+ * usage:
+ *   UpscalerBench [-t threads] [-j out.json] [-b baseline.json] [-r percent] [file.tdf]
+ *
+ * Resizes a thermal image, either from a TDF file (see doc/TDF_Fileformat.txt)
+ * or a synthetic 32x24 scene, to several output sizes with every kernel and
+ * every instruction set supported by this cpu. Prints Mpixel/s, the speedup
+ * and the max abs difference to the scalar output; exits with 1 if any
+ * variant is off by more than 'Tolerance'. The same for the horizontal pass
+ * alone, in ns per interpolated column.
+ * FixedSize::Upscaler for the sketch's 32x24 -> 300x220 has to match Upscaler
+ * the same way, full frame and in strips of 20 rows (synthetic scene or a
+ * 32x24 file only).
+ * Then, bicubic with the default (best) isa on a pool of 1..threads threads (default:
+ * cpu cores), to see where memory bandwidth takes over. Parallel output has
+ * to be identical to the single threaded one.
+ * Last, the timing cases: each kernel, full frame vs. strips vs. streamed
+ * rows (NextRows()) at several strip heights, float and RGB565 output, at
+ * several output sizes. Reports ns per output pixel, ms per frame and
+ * Mpixel/s, as JSON with -j. With -b, each case is compared against the
+ * same case of a JSON file saved before; cases slower by more than -r
+ * percent (default 10) are flagged, and the exit code is then 3.
+ ******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "UpScaler.h"
+#include "UpScalerFixedSize.h"
+
+namespace {
+
+const float Tolerance = 1e-4f;
+
+struct Size {
+  uint16_t Width;
+  uint16_t Height;
+};
+
+const Size OutputSizes[] = {
+  { 320, 240}, { 640, 480}, {1280, 960}, {2560, 1920}
+};
+
+const UpscalerKernel Kernels[] = {
+  UpscalerKernel::Nearest, UpscalerKernel::Bilinear, UpscalerKernel::Bicubic
+};
+
+const UpscalerISA ISAs[] = {
+  UpscalerISA::Scalar, UpscalerISA::SSE41, UpscalerISA::AVX2, UpscalerISA::NEON
+};
+
+const char* KernelName(UpscalerKernel Kernel) {
+  switch(Kernel) {
+     case UpscalerKernel::Nearest:  return "nearest";
+     case UpscalerKernel::Bilinear: return "bilinear";
+     default:                       return "bicubic";
+     }
+}
+
+/* TDF: "TDF\0", uint16 width, uint16 height, width * height floats. */
+bool ReadTDF(const char* Name, std::vector<float>& Image, uint16_t& Width, uint16_t& Height) {
+  FILE* f = fopen(Name, "rb");
+  if (!f)
+     return false;
+
+  char Magic[4];
+  bool Ok = fread(Magic, 1, 4, f) == 4 and Magic[0] == 'T' and Magic[1] == 'D' and
+            Magic[2] == 'F' and Magic[3] == 0 and
+            fread(&Width, 2, 1, f) == 1 and fread(&Height, 2, 1, f) == 1 and
+            Width > 1 and Height > 1;
+  if (Ok) {
+     Image.resize(Width * Height);
+     Ok = fread(Image.data(), sizeof(float), Image.size(), f) == Image.size();
+     }
+  fclose(f);
+  return Ok;
+}
+
+/* a warm blob and a hot spot on a background gradient, with some sensor like noise. */
+void Synthetic(std::vector<float>& Image, uint16_t Width, uint16_t Height) {
+  uint32_t Seed = 12345;
+  Image.resize(Width * Height);
+  for(uint16_t y = 0; y < Height; y++)
+     for(uint16_t x = 0; x < Width; x++) {
+        float dx = x - Width * 0.4f, dy = y - Height * 0.5f;
+        float hx = x - Width * 0.8f, hy = y - Height * 0.2f;
+        Seed = Seed * 1103515245 + 12345;
+        Image[y * Width + x] = 20.0f + 0.1f * y +
+                               14.0f * expf(-(dx * dx + dy * dy) / 40.0f) +
+                               40.0f * expf(-(hx * hx + hy * hy) / 2.0f) +
+                               0.2f * ((Seed >> 16) & 0xFF) / 255.0f;
+        }
+}
+
+void Resize(Upscaler& Scaler, UpscalerKernel Kernel) {
+  switch(Kernel) {
+     case UpscalerKernel::Nearest:  Scaler.ResizeNearest();  break;
+     case UpscalerKernel::Bilinear: Scaler.ResizeBilinear(); break;
+     default:                       Scaler.ResizeBicubic();
+     }
+}
+
+/* best of a few runs, in seconds. */
+double Measure(Upscaler& Scaler, UpscalerKernel Kernel, uint32_t Pixels) {
+  uint32_t Runs = 1 + 20000000 / Pixels;
+  double Best = 1e9;
+  Resize(Scaler, Kernel); // tables, caches
+  for(uint32_t i = 0; i < Runs; i++) {
+     auto t0 = std::chrono::steady_clock::now();
+     Resize(Scaler, Kernel);
+     double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+     if (t < Best)
+        Best = t;
+     }
+  return Best;
+}
+
+/* the horizontal pass alone over the padded input rows of one frame, as
+ * run by 'isa': best of a few runs, in seconds. Out receives the rows.
+ */
+template<class Kernel>
+double MeasureHorizontal(const std::vector<float>& Padded, uint16_t Width, uint16_t Height, uint16_t OutWidth,
+                         UpscalerISA isa, std::vector<float>& Out) {
+  uint16_t Stride = Width + 2 * UpscalerPad;
+  uint16_t Rows   = Height + 2 * UpscalerPad;
+  std::vector<UpscalerTap<4>>   Cols(OutWidth);
+  std::vector<UpscalerTapBlock> Blocks(OutWidth / 8 + 1);
+
+  for(uint16_t x = 0; x < OutWidth; x++)
+     BuildTap<Kernel>(Cols[x], x, OutWidth, Width);
+  bool Vector = BuildTapBlocks<Kernel>(Cols.data(), OutWidth, Stride, Blocks.data());
+  UpscalerHorizontal Pass(0, Vector ? UpscalerHorizontalRow(isa) : NULL, Blocks.data());
+
+  Out.resize(Rows * OutWidth);
+  uint32_t Runs = 1 + 2000000 / (Rows * OutWidth);
+  double Best = 1e9;
+  for(uint32_t i = 0; i <= Runs; i++) {
+     auto t0 = std::chrono::steady_clock::now();
+     for(uint16_t r = 0; r < Rows; r++)
+        HorizontalPass<Kernel>(&Padded[r * Stride], Cols.data(), Pass, &Out[r * OutWidth], 0, OutWidth);
+     double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+     if (t < Best)
+        Best = t;
+     }
+  return Best;
+}
+
+double MeasureHorizontal(UpscalerKernel Kernel, const std::vector<float>& Padded, uint16_t Width, uint16_t Height,
+                         uint16_t OutWidth, UpscalerISA isa, std::vector<float>& Out) {
+  switch(Kernel) {
+     case UpscalerKernel::Nearest:  return MeasureHorizontal<NearestKernel> (Padded, Width, Height, OutWidth, isa, Out);
+     case UpscalerKernel::Bilinear: return MeasureHorizontal<BilinearKernel>(Padded, Width, Height, OutWidth, isa, Out);
+     default:                       return MeasureHorizontal<BicubicKernel> (Padded, Width, Height, OutWidth, isa, Out);
+     }
+}
+
+/* max abs difference of FixedSize::Upscaler to Upscaler, for the sketch's
+ * geometry, over the full frame and the frame in strips of 20 rows.
+ */
+template<class Kernel>
+float CompareFixedSize(const std::vector<float>& Input, UpscalerKernel Id) {
+  const uint16_t Width = 300, Height = 220, StripHeight = 20;
+  static FixedSize::Upscaler<32, 24, Width, Height, Kernel> Fixed;
+  std::vector<float> Reference(Width * Height), Output(Width * Height);
+
+  Upscaler Scaler;
+  Scaler.SetInputImage(Input.data(), 32, 24);
+  Scaler.SetOutputImage(Reference.data(), Width, Height);
+  Resize(Scaler, Id);
+
+  Fixed.SetInputImage(Input.data());
+  Fixed.Resize(Output.data());
+  float MaxDiff = 0;
+  for(uint32_t i = 0; i < Output.size(); i++)
+     MaxDiff = fmaxf(MaxDiff, fabsf(Output[i] - Reference[i]));
+
+  for(uint16_t y = 0; y < Height; y += StripHeight) {
+     Fixed.Resize(Output.data(), 0, y, Width, StripHeight);
+     for(uint32_t i = 0; i < Width * StripHeight; i++)
+        MaxDiff = fmaxf(MaxDiff, fabsf(Output[i] - Reference[y * Width + i]));
+     }
+  return MaxDiff;
+}
+
+/* timing cases */
+const Size CaseSizes[] = {
+  { 300, 220}, { 320, 240}, { 640, 480}, {1280, 960}
+};
+
+/* 20: the sketch's former PARTH, 44: the current one. */
+const uint16_t StripHeights[] = { 1, 8, 20, 44 };
+
+enum class Mode : uint8_t { Full, Strip, Stream };
+
+struct Result {
+  std::string Name;
+  double      NsPerPixel;
+  double      Ms;
+  double      MPixelPerSecond;
+};
+
+/* median ms of as many runs as fit into about 50ms, at least 5. */
+double Median(const std::function<void()>& Frame) {
+  Frame(); // tables, caches
+  std::vector<double> Times;
+  double Total = 0;
+  while(Times.size() < 5 or (Total < 0.05 and Times.size() < 1000)) {
+     auto t0 = std::chrono::steady_clock::now();
+     Frame();
+     double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+     Times.push_back(t * 1e3);
+     Total += t;
+     }
+  std::sort(Times.begin(), Times.end());
+  return Times[Times.size() / 2];
+}
+
+void Strip(Upscaler& Scaler, UpscalerKernel Kernel, float* Part, uint16_t X, uint16_t Y, uint16_t w, uint16_t h) {
+  switch(Kernel) {
+     case UpscalerKernel::Nearest:  Scaler.ResizeNearest (Part, X, Y, w, h); break;
+     case UpscalerKernel::Bilinear: Scaler.ResizeBilinear(Part, X, Y, w, h); break;
+     default:                       Scaler.ResizeBicubic (Part, X, Y, w, h);
+     }
+}
+
+void Strip(Upscaler& Scaler, UpscalerKernel Kernel, uint16_t* Part, uint16_t X, uint16_t Y, uint16_t w, uint16_t h,
+           const uint16_t* Palette) {
+  switch(Kernel) {
+     case UpscalerKernel::Nearest:  Scaler.ResizeNearest (Part, X, Y, w, h, Palette, 256, 20.0f, 60.0f); break;
+     case UpscalerKernel::Bilinear: Scaler.ResizeBilinear(Part, X, Y, w, h, Palette, 256, 20.0f, 60.0f); break;
+     default:                       Scaler.ResizeBicubic (Part, X, Y, w, h, Palette, 256, 20.0f, 60.0f);
+     }
+}
+
+/* one frame of 'Mode': float or, with a Palette, RGB565 output. */
+Result Case(const std::vector<float>& Input, uint16_t Width, uint16_t Height, const Size& s,
+            UpscalerKernel Kernel, Mode m, uint16_t StripHeight, const uint16_t* Palette) {
+  uint32_t Pixels = s.Width * s.Height;
+  std::vector<float>    Image(m == Mode::Full ? Pixels : 0);
+  std::vector<float>    Part(s.Width * StripHeight);
+  std::vector<uint16_t> Colors(s.Width * StripHeight);
+
+  Upscaler Scaler;
+  Scaler.SetInputImage(Input.data(), Width, Height);
+  Scaler.SetOutputImage(m == Mode::Full ? Image.data() : NULL, s.Width, s.Height);
+
+  std::function<void()> Frame;
+  char Name[64];
+  const char* Type = Palette ? "rgb565" : "float";
+
+  switch(m) {
+     case Mode::Full:
+        snprintf(Name, sizeof(Name), "%s/full/%s/%ux%u", KernelName(Kernel), Type, s.Width, s.Height);
+        Frame = [&] { Resize(Scaler, Kernel); };
+        break;
+     case Mode::Strip:
+        snprintf(Name, sizeof(Name), "%s/strip%u/%s/%ux%u", KernelName(Kernel), StripHeight, Type,
+                 s.Width, s.Height);
+        Frame = [&] {
+           for(uint16_t y = 0; y < s.Height; y += StripHeight) {
+              uint16_t h = s.Height - y < StripHeight ? s.Height - y : StripHeight;
+              if (Palette)
+                 Strip(Scaler, Kernel, Colors.data(), 0, y, s.Width, h, Palette);
+              else
+                 Strip(Scaler, Kernel, Part.data(), 0, y, s.Width, h);
+              }
+           };
+        break;
+     case Mode::Stream:
+        snprintf(Name, sizeof(Name), "%s/stream%u/%s/%ux%u", KernelName(Kernel), StripHeight, Type,
+                 s.Width, s.Height);
+        Frame = [&] {
+           Scaler.BeginStrips(Kernel);
+           if (Palette)
+              while(Scaler.NextRows(Colors.data(), StripHeight, Palette, 256, 20.0f, 60.0f));
+           else
+              while(Scaler.NextRows(Part.data(), StripHeight));
+           };
+        break;
+     }
+
+  double Ms = Median(Frame);
+  return Result{ Name, Ms * 1e6 / Pixels, Ms, Pixels / Ms * 1e-3 };
+}
+
+bool WriteJSON(const char* File, const std::vector<Result>& Results) {
+  FILE* f = fopen(File, "w");
+  if (!f)
+     return false;
+
+  fprintf(f, "{\n  \"isa\": \"%s\",\n  \"cases\": [\n", UpscalerISAName(UpscalerBestISA()));
+  for(size_t i = 0; i < Results.size(); i++) {
+     const Result& r = Results[i];
+     fprintf(f, "    {\"name\": \"%s\", \"ns_per_pixel\": %.4f, \"ms\": %.5f, \"mpixel_per_s\": %.2f}%s\n",
+             r.Name.c_str(), r.NsPerPixel, r.Ms, r.MPixelPerSecond, i + 1 < Results.size() ? "," : "");
+     }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0;
+}
+
+/* reads name and ns_per_pixel of each case of a file written by WriteJSON(). */
+bool ReadJSON(const char* File, std::map<std::string, double>& Baseline) {
+  FILE* f = fopen(File, "r");
+  if (!f)
+     return false;
+
+  char Line[256];
+  while(fgets(Line, sizeof(Line), f)) {
+     const char* n = strstr(Line, "\"name\": \"");
+     const char* v = strstr(Line, "\"ns_per_pixel\": ");
+     if (!n or !v)
+        continue;
+     n += 9;
+     const char* e = strchr(n, '"');
+     if (e)
+        Baseline[std::string(n, e - n)] = atof(v + 16);
+     }
+  fclose(f);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<float> Input;
+  uint16_t Width = 32, Height = 24;
+  const char* File = NULL;
+  const char* JSON = NULL;
+  const char* BaselineFile = NULL;
+  double Threshold = 10.0;
+  unsigned MaxThreads = std::thread::hardware_concurrency();
+
+  for(int i = 1; i < argc; i++) {
+     if (!strcmp(argv[i], "-t") and i + 1 < argc)
+        MaxThreads = atoi(argv[++i]);
+     else if (!strcmp(argv[i], "-j") and i + 1 < argc)
+        JSON = argv[++i];
+     else if (!strcmp(argv[i], "-b") and i + 1 < argc)
+        BaselineFile = argv[++i];
+     else if (!strcmp(argv[i], "-r") and i + 1 < argc)
+        Threshold = atof(argv[++i]);
+     else
+        File = argv[i];
+     }
+
+  std::map<std::string, double> Baseline;
+  if (BaselineFile and !ReadJSON(BaselineFile, Baseline)) {
+     fprintf(stderr, "could not read %s\n", BaselineFile);
+     return 2;
+     }
+  if (MaxThreads < 1)   MaxThreads = 1;
+  if (MaxThreads > 255) MaxThreads = 255;
+
+  if (File) {
+     if (!ReadTDF(File, Input, Width, Height)) {
+        fprintf(stderr, "could not read %s\n", File);
+        return 2;
+        }
+     }
+  else
+     Synthetic(Input, Width, Height);
+
+  printf("input %ux%u, best isa %s\n", Width, Height, UpscalerISAName(UpscalerBestISA()));
+  printf("%-10s %-9s %-7s %10s %8s %12s\n", "output", "kernel", "isa", "Mpixel/s", "speedup", "max diff");
+
+  bool Failed = false;
+  for(const Size& s : OutputSizes) {
+     uint32_t Pixels = s.Width * s.Height;
+     std::vector<float> Reference(Pixels), Output(Pixels);
+     char Geometry[16];
+     snprintf(Geometry, sizeof(Geometry), "%ux%u", s.Width, s.Height);
+
+     for(UpscalerKernel Kernel : Kernels) {
+        double Scalar = 0;
+        for(UpscalerISA isa : ISAs) {
+           if (!UpscalerHasISA(isa))
+              continue;
+
+           Upscaler Scaler;
+           Scaler.SetISA(isa);
+           Scaler.SetInputImage(Input.data(), Width, Height);
+           Scaler.SetOutputImage(isa == UpscalerISA::Scalar ? Reference.data() : Output.data(),
+                                 s.Width, s.Height);
+           double t = Measure(Scaler, Kernel, Pixels);
+           if (isa == UpscalerISA::Scalar)
+              Scalar = t;
+
+           float MaxDiff = 0;
+           if (isa != UpscalerISA::Scalar)
+              for(uint32_t i = 0; i < Pixels; i++)
+                 MaxDiff = fmaxf(MaxDiff, fabsf(Output[i] - Reference[i]));
+           bool Ok = MaxDiff <= Tolerance;
+           Failed |= !Ok;
+
+           printf("%-10s %-9s %-7s %10.1f %8.2f %12.3g%s\n", Geometry, KernelName(Kernel),
+                  UpscalerISAName(isa), Pixels / t * 1e-6, Scalar / t, MaxDiff, Ok ? "" : "  FAILED");
+           }
+        }
+     }
+
+  if (Width == 32 and Height == 24) {
+     printf("\n%-10s %-9s %12s\n", "fixed size", "kernel", "max diff");
+     for(UpscalerKernel Kernel : Kernels) {
+        float MaxDiff;
+        switch(Kernel) {
+           case UpscalerKernel::Nearest:  MaxDiff = CompareFixedSize<NearestKernel> (Input, Kernel); break;
+           case UpscalerKernel::Bilinear: MaxDiff = CompareFixedSize<BilinearKernel>(Input, Kernel); break;
+           default:                       MaxDiff = CompareFixedSize<BicubicKernel> (Input, Kernel);
+           }
+        bool Ok = MaxDiff <= Tolerance;
+        Failed |= !Ok;
+        printf("%-10s %-9s %12.3g%s\n", "300x220", KernelName(Kernel), MaxDiff, Ok ? "" : "  FAILED");
+        }
+     }
+
+  /* the horizontal pass, where the isas differ; its share of a full resize
+   * shrinks with the output height.
+   */
+  std::vector<float> Padded((Width + 2 * UpscalerPad) * (Height + 2 * UpscalerPad));
+  PadImage(Input.data(), Width, Height, Padded.data(), UpscalerBorder::Replicate);
+
+  printf("\n%-10s %-9s %-7s %10s %8s %12s\n", "width", "kernel", "isa", "ns/column", "speedup", "max diff");
+  for(const Size& s : OutputSizes) {
+     uint32_t Columns = s.Width * (Height + 2 * UpscalerPad);
+     std::vector<float> Reference, Output;
+
+     for(UpscalerKernel Kernel : Kernels) {
+        double Scalar = MeasureHorizontal(Kernel, Padded, Width, Height, s.Width, UpscalerISA::Scalar, Reference);
+        for(UpscalerISA isa : ISAs) {
+           if (!UpscalerHasISA(isa))
+              continue;
+
+           double t = Scalar;
+           float MaxDiff = 0;
+           if (isa != UpscalerISA::Scalar) {
+              t = MeasureHorizontal(Kernel, Padded, Width, Height, s.Width, isa, Output);
+              for(uint32_t i = 0; i < Columns; i++)
+                 MaxDiff = fmaxf(MaxDiff, fabsf(Output[i] - Reference[i]));
+              }
+           bool Ok = MaxDiff <= Tolerance;
+           Failed |= !Ok;
+
+           printf("%-10u %-9s %-7s %10.3f %8.2f %12.3g%s\n", s.Width, KernelName(Kernel),
+                  UpscalerISAName(isa), t * 1e9 / Columns, Scalar / t, MaxDiff, Ok ? "" : "  FAILED");
+           }
+        }
+     }
+
+  printf("\n%-10s %-7s %10s %8s %12s\n", "output", "threads", "Mpixel/s", "speedup", "max diff");
+  for(const Size& s : OutputSizes) {
+     uint32_t Pixels = s.Width * s.Height;
+     std::vector<float> Reference(Pixels), Output(Pixels);
+     char Geometry[16];
+     snprintf(Geometry, sizeof(Geometry), "%ux%u", s.Width, s.Height);
+
+     Upscaler Scaler;
+     Scaler.SetInputImage(Input.data(), Width, Height);
+     Scaler.SetOutputImage(Reference.data(), s.Width, s.Height);
+     double Single = Measure(Scaler, UpscalerKernel::Bicubic, Pixels);
+     printf("%-10s %-7u %10.1f %8.2f %12.3g\n", Geometry, 1, Pixels / Single * 1e-6, 1.0, 0.0);
+
+     for(unsigned Threads = 2; Threads <= MaxThreads; Threads++) {
+        UpscalerPool Pool(Threads);
+        Scaler.SetOutputImage(Output.data(), s.Width, s.Height);
+        Scaler.SetThreadPool(&Pool);
+        double t = Measure(Scaler, UpscalerKernel::Bicubic, Pixels);
+        Scaler.SetThreadPool(NULL);
+
+        float MaxDiff = 0;
+        for(uint32_t i = 0; i < Pixels; i++)
+           MaxDiff = fmaxf(MaxDiff, fabsf(Output[i] - Reference[i]));
+        bool Ok = MaxDiff == 0;
+        Failed |= !Ok;
+
+        printf("%-10s %-7u %10.1f %8.2f %12.3g%s\n", Geometry, Threads, Pixels / t * 1e-6,
+               Single / t, MaxDiff, Ok ? "" : "  FAILED");
+        }
+     }
+
+  // a 256 entry gray ramp stands in for the display palette.
+  uint16_t Palette[256];
+  for(uint16_t i = 0; i < 256; i++)
+     Palette[i] = ((i >> 3) << 11) | ((i >> 2) << 5) | (i >> 3);
+
+  std::vector<Result> Results;
+  for(const Size& s : CaseSizes)
+     for(UpscalerKernel Kernel : Kernels) {
+        Results.push_back(Case(Input, Width, Height, s, Kernel, Mode::Full, 1, NULL));
+        for(uint16_t h : StripHeights)
+           for(const uint16_t* p : { (const uint16_t*) NULL, (const uint16_t*) Palette }) {
+              Results.push_back(Case(Input, Width, Height, s, Kernel, Mode::Strip,  h, p));
+              Results.push_back(Case(Input, Width, Height, s, Kernel, Mode::Stream, h, p));
+              }
+        }
+
+  bool Regressed = false;
+  printf("\n%-38s %10s %10s %10s %9s\n", "case", "ns/pixel", "ms", "Mpixel/s", "baseline");
+  for(const Result& r : Results) {
+     printf("%-38s %10.3f %10.4f %10.1f", r.Name.c_str(), r.NsPerPixel, r.Ms, r.MPixelPerSecond);
+     auto b = Baseline.find(r.Name);
+     if (b != Baseline.end() and b->second > 0) {
+        double Change = (r.NsPerPixel / b->second - 1.0) * 100.0;
+        bool Slower = Change > Threshold;
+        Regressed |= Slower;
+        printf(" %+8.1f%%%s", Change, Slower ? "  REGRESSION" : "");
+        }
+     printf("\n");
+     }
+
+  if (JSON and !WriteJSON(JSON, Results)) {
+     fprintf(stderr, "could not write %s\n", JSON);
+     return 2;
+     }
+
+  return Failed ? 1 : Regressed ? 3 : 0;
+}
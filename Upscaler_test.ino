@@ -5,19 +5,33 @@
 #include <EEPROM.h>
 #include "FS.h"
 #include "SD.h"
+#include "SPIFFS.h"
 #include "M5CoreDisplay.h"
 #include "UpScaler.h"
 #include "IronBow.h"
 #include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640Cache.h"
 #pragma GCC optimize ("O3")
 
 auto LCD = M5CoreDisplay();
-auto Scaler = Upscaler();
+Upscaler Scaler;
 long long t1, t2;
 float temps[32*24];
 
-#define SCALE_X 300
-#define SCALE_Y 220
+/* 1: use the whole 320x240 display for the image, an exact 10x of the
+ * sensor, which allows the faster polyphase upscale. Color bar and texts
+ * are then redrawn on top of the image after each frame.
+ */
+#define FULLSCREEN 0
+
+#if FULLSCREEN
+   #define SCALE_X 320
+   #define SCALE_Y 240
+#else
+   #define SCALE_X 300
+   #define SCALE_Y 220
+#endif
 #define MINTEMP 20
 #define MAXTEMP 50
 
@@ -31,6 +45,12 @@ void Restore(void);
 void SaveToSD(void);
 
 paramsMLX90640 sensorCal;
+preparedMLX90640 sensorPrepared;
+correctionPlanMLX90640 sensorCorrection;
+schedulerMLX90640 sensorScheduler;
+acquisitionMLX90640 sensorAcquisition;
+uint16_t RAMdata[834]; /* filled by sensorAcquisition, also during the render */
+MLX90640Cache calibrationCache(SPIFFS, "/mlx90640.cal");
 float tmin = 20.0f, tmax = 60.0f;
 
 #define NumEmissivities 9
@@ -41,7 +61,21 @@ uint8_t     emIndex = 1;
 float crossv;
 int UpdateEEprom = -1;
 
+const uint16_t PARTW = SCALE_X;
+const uint16_t PARTH = 44;
+const uint16_t PARTSZ = PARTW * PARTH;
+const uint16_t PARTS = (SCALE_Y + PARTH - 1) / PARTH;
+
+uint16_t part[PARTSZ]; /* upscaled and color mapped strip, RGB565 */
+
+/* the frame read takes a step after each of the PARTS strips: data ready,
+ * the RAM in PARTS - 2 chunks and the final check.
+ */
+const uint16_t CHUNK = PARTS > 2 ? (832 + PARTS - 3) / (PARTS - 2) : 832;
+
 void setup() {
+  // a frame (832 words) in one I2C transaction, where Wire's buffer can grow
+  MLX90640_I2CSetBurstLength(1664);
   Wire.begin();
   EEPROM.begin(6);
   Serial.begin(115200);
@@ -56,12 +90,26 @@ void setup() {
   LCD.setCursor(150,230);
   LCD.print("to SD");
 
-  Scaler.SetInputImage(temps, 32, 24);
   Scaler.SetOutputImage(NULL, SCALE_X, SCALE_Y);
-
-  uint16_t sensorEeprom[832];
-  MLX90640_DumpEE(0x33, sensorEeprom);
-  MLX90640_ExtractParameters(sensorEeprom, &sensorCal);
+#if FULLSCREEN
+  Scaler.SetSampling(UpscalerSampling::Aligned);
+#endif
+
+  // calibration from flash, if it's the one of this sensor; otherwise
+  // dump and extract it and save it for the next start.
+  uint16_t deviceId[3];
+  bool cached = SPIFFS.begin(true) and
+                MLX90640Cache::DeviceId(0x33, deviceId) == 0 and
+                calibrationCache.Load(deviceId, &sensorCal);
+  if (not cached) {
+     uint16_t sensorEeprom[832];
+     MLX90640_DumpEE(0x33, sensorEeprom);
+     if (MLX90640_ExtractParameters(sensorEeprom, &sensorCal) == 0)
+        calibrationCache.Save(sensorEeprom + 7, &sensorCal);
+     }
+  MLX90640_PrepareParameters(&sensorCal, &sensorPrepared);
+  // broken and outlier pixels of the EEPROM, add known dead ones here.
+  MLX90640_BuildCorrectionPlan(&sensorCal, NULL, 0, &sensorCorrection);
 
     // 0 – 0.5Hz
     // 1 – 1Hz
@@ -77,6 +125,10 @@ void setup() {
     // 2 18 bit
     // 3 19 bit
   MLX90640_SetResolution(0x33, 3);
+  // sleeps until shortly before each subpage instead of polling for it
+  MLX90640_InitScheduler(0x33, &sensorScheduler);
+  // one step after each display strip
+  MLX90640_InitAcquisition(&sensorAcquisition, 0x33, &sensorScheduler, CHUNK);
 
   pinMode(37, INPUT_PULLUP);
   pinMode(38, INPUT_PULLUP);
@@ -85,27 +137,6 @@ void setup() {
 
 
 
-const uint16_t PARTW = 300;
-const uint16_t PARTH = 20;
-const uint16_t PARTSZ = PARTW * PARTH;
-
-float part[PARTSZ]; /* upscaled temp samples */
-
-
-float slope;
-float inMin;
-
-void SetSlope(float iMin, float iMax, float oMin, float oMax) {
-  slope = (oMax - oMin) / (iMax - iMin);
-  inMin = iMin;
-}
-
-int Map(float f) {
-  return (f-inMin)*slope;
-}
-
-
-
 void loop() {
 
   t1 = millis();
@@ -147,17 +178,20 @@ void loop() {
      }
 
   for(int i=0; i<2; i++) {
-     uint16_t RAMdata[834];
-     MLX90640_GetFrameData(0x33, RAMdata);
+     // the first subpage was started before the last render
+     if (i == 1 or sensorAcquisition.state == MLX90640_ACQUISITION_IDLE)
+        MLX90640_StartAcquisition(&sensorAcquisition, RAMdata);
+     MLX90640_CompleteAcquisition(&sensorAcquisition);
 
-     //float vdd = MLX90640_GetVdd(RAMdata, &sensorCal);
-     float Ta  = MLX90640_GetTa(RAMdata, &sensorCal);
+     frameContextMLX90640 frame;
+     MLX90640_GetFrameContext(RAMdata, &sensorCal, &frame);
+
+     float Ta  = MLX90640_GetTa(&frame);
      float tr  = Ta - 8.0f;
-     
-     MLX90640_CalculateTo(RAMdata, &sensorCal, emissivities[emIndex], tr, temps);
+     MLX90640_SetFrameEmissivity(&frame, emissivities[emIndex], tr);
 
-     int interleave = MLX90640_GetCurMode(0x33);
-     MLX90640_BadPixelsCorrection((&sensorCal)->brokenPixels, temps, interleave, &sensorCal);
+     MLX90640_CalculateToPrepared(RAMdata, &sensorCal, &sensorPrepared, &frame, temps);
+     MLX90640_ApplyCorrectionPlan(&sensorCorrection, temps, &frame);
      }
 
   // flip image in x (sensor mounted at backside)
@@ -173,27 +207,29 @@ void loop() {
      offset+=32;
      }
 
+  Scaler.SetInputImage(temps, 32, 24);
+
   crossv =(temps[15 * 32 + 11] +
            temps[15 * 32 + 12] +
            temps[16 * 32 + 11] +
            temps[16 * 32 + 12])*0.25f;
   CrossHair(150,110,crossv);
 
-  SetSlope(tmin-1.0f,tmax+1.0f,0,2047);
-
+  MLX90640_StartAcquisition(&sensorAcquisition, RAMdata);
+  Scaler.BeginStrips();
   for(int y=0; y<SCALE_Y; y+=PARTH)  {
-     for(int x=0; x<SCALE_X; x+=PARTW) {
-        LCD.setAddrWindow(x, y, PARTW, PARTH);
-        Scaler.ResizeBicubic(part, x, y, PARTW, PARTH);
-
-        uint16_t* tmp = (uint16_t*) part;
-        for(int i=0; i<PARTSZ; i++) {
-           int idx = constrain(Map(part[i]), 0, 2047);
-           tmp[i] = Ironbow2048[idx];
-           }
-        LCD.pushColors(tmp, PARTSZ);
-        }
+     int h = Scaler.NextRows(part, PARTH, Ironbow2048, 2048, tmin-1.0f, tmax+1.0f);
+     LCD.setAddrWindow(0, y, PARTW, h);
+     LCD.pushColors(part, PARTW * h);
+     MLX90640_PollAcquisition(&sensorAcquisition);
      }
+#if FULLSCREEN
+  PrintTmin();
+  PrintTmax();
+  PrintEmissivity();
+  LCD.setCursor(150,230);
+  LCD.print("to SD");
+#endif
   t2 = millis();
   Serial.println(t2-t1); // 1277ms. 1100ms sleep -> 177ms
 